@@ -0,0 +1,205 @@
+//
+//  AttackMap.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "AttackMap.hpp"
+#include "Attacks.hpp"
+
+#include <cstring>
+
+namespace
+{
+    // Indexed by Piece, for deciding whether an exchange loses material
+    const int pieceValues[13] = {0, 1, 5, 3, 3, 9, 100, 1, 5, 3, 3, 9, 100};
+
+    bool isWhite(Piece piece)
+    {
+        return piece != Piece::NONE && (int)piece <= (int)Piece::WHITEKING;
+    }
+
+    bool isSlider(Piece piece)
+    {
+        int type = ((int)piece - 1) % 6;
+        return piece != Piece::NONE && type >= 1 && type <= 4 && type != 3;
+    }
+
+    uint64_t attacksFrom(Piece piece, int square, uint64_t occupancy)
+    {
+        switch (piece)
+        {
+            case Piece::WHITEPAWN:   return Attacks::pawn(square, true);
+            case Piece::BLACKPAWN:   return Attacks::pawn(square, false);
+            case Piece::WHITEKNIGHT:
+            case Piece::BLACKKNIGHT: return Attacks::knight(square);
+            case Piece::WHITEBISHOP:
+            case Piece::BLACKBISHOP: return Attacks::bishop(square, occupancy);
+            case Piece::WHITEROOK:
+            case Piece::BLACKROOK:   return Attacks::rook(square, occupancy);
+            case Piece::WHITEQUEEN:
+            case Piece::BLACKQUEEN:  return Attacks::queen(square, occupancy);
+            case Piece::WHITEKING:
+            case Piece::BLACKKING:   return Attacks::king(square);
+            default:                 return 0;
+        }
+    }
+
+    uint64_t occupancyOf(const Board& board)
+    {
+        uint64_t occupancy = 0;
+        for (int p = (int)Piece::WHITEPAWN; p <= (int)Piece::BLACKKING; p++)
+            occupancy |= board.getBitboard(static_cast<Piece>(p));
+        return occupancy;
+    }
+}
+
+AttackMap::AttackMap()
+{
+    reset(Board());
+}
+
+void AttackMap::place(int square, Piece piece)
+{
+    uint64_t bit = 1ULL << square;
+    occupant[square] = piece;
+    whitePieces = isWhite(piece) ? whitePieces | bit : whitePieces & ~bit;
+    sliders = isSlider(piece) ? sliders | bit : sliders & ~bit;
+}
+
+// Every target of a removed or added attack set is marked changed: a count
+// can change while the square stays attacked, and the piece counted may be
+// another one, which matters for hanging pieces
+void AttackMap::remove(int square)
+{
+    bool white = isWhite(occupant[square]);
+    for (uint64_t targets = from[square]; targets; targets &= targets - 1)
+        counts[white][__builtin_ctzll(targets)]--;
+
+    dirty |= from[square];
+}
+
+void AttackMap::add(int square, uint64_t occupancy)
+{
+    from[square] = attacksFrom(occupant[square], square, occupancy);
+
+    bool white = isWhite(occupant[square]);
+    for (uint64_t targets = from[square]; targets; targets &= targets - 1)
+        counts[white][__builtin_ctzll(targets)]++;
+
+    dirty |= from[square];
+}
+
+void AttackMap::reset(const Board& board)
+{
+    std::memset(counts, 0, sizeof(counts));
+    std::memset(from, 0, sizeof(from));
+
+    uint64_t occupancy = occupancyOf(board);
+    for (int square = 0; square < 64; square++)
+    {
+        place(square, board.get(Attacks::row(square), Attacks::col(square)));
+        add(square, occupancy);
+    }
+
+    dirty = ~0ULL;
+}
+
+void AttackMap::update(const Board& board, const Move& move)
+{
+    uint64_t changed = (1ULL << move.from) | (1ULL << move.to);
+
+    if (move.flags & MOVE_EN_PASSANT)
+        changed |= 1ULL << Attacks::square(Attacks::row(move.from), Attacks::col(move.to));
+
+    if (move.flags & MOVE_CASTLE)
+    {
+        int row = Attacks::row(move.to);
+        bool kingSide = Attacks::col(move.to) == 6;
+        changed |= 1ULL << Attacks::square(row, kingSide ? 7 : 0);
+        changed |= 1ULL << Attacks::square(row, kingSide ? 5 : 3);
+    }
+
+    // A slider sees a square whose occupant changed exactly when the square
+    // is in its attack set: either as the blocker that left or as the empty
+    // square that got filled
+    uint64_t affected = changed;
+    for (uint64_t squares = sliders & ~changed; squares; squares &= squares - 1)
+        if (from[__builtin_ctzll(squares)] & changed)
+            affected |= squares & -squares;
+
+    for (uint64_t squares = affected; squares; squares &= squares - 1)
+        remove(__builtin_ctzll(squares));
+
+    for (uint64_t squares = changed; squares; squares &= squares - 1)
+    {
+        int square = __builtin_ctzll(squares);
+        place(square, board.get(Attacks::row(square), Attacks::col(square)));
+    }
+
+    uint64_t occupancy = occupancyOf(board);
+    for (uint64_t squares = affected; squares; squares &= squares - 1)
+        add(__builtin_ctzll(squares), occupancy);
+
+    dirty |= changed;
+}
+
+uint64_t AttackMap::attacked(bool byWhite) const
+{
+    uint64_t result = 0;
+    for (int square = 0; square < 64; square++)
+        if (counts[byWhite][square])
+            result |= 1ULL << square;
+    return result;
+}
+
+uint64_t AttackMap::attackersOf(int square, bool byWhite) const
+{
+    uint64_t result = 0;
+    for (uint64_t pieces = byWhite ? whitePieces : ~whitePieces; pieces; pieces &= pieces - 1)
+        if (from[__builtin_ctzll(pieces)] >> square & 1)
+            result |= pieces & -pieces;
+    return result;
+}
+
+bool AttackMap::isHanging(int square) const
+{
+    Piece piece = occupant[square];
+    if (piece == Piece::NONE || piece == Piece::WHITEKING || piece == Piece::BLACKKING)
+        return false;
+
+    bool white = isWhite(piece);
+    if (!counts[!white][square])
+        return false;
+    if (!counts[white][square])
+        return true;
+
+    for (uint64_t enemies = attackersOf(square, !white); enemies; enemies &= enemies - 1)
+        if (pieceValues[(int)occupant[__builtin_ctzll(enemies)]] < pieceValues[(int)piece])
+            return true;
+
+    return false;
+}
+
+uint64_t AttackMap::hanging(bool white) const
+{
+    uint64_t result = 0;
+    for (int square = 0; square < 64; square++)
+        if (occupant[square] != Piece::NONE && isWhite(occupant[square]) == white && isHanging(square))
+            result |= 1ULL << square;
+    return result;
+}
+
+int AttackMap::takeChanges(SquareState* changes)
+{
+    int count = 0;
+    for (uint64_t squares = dirty; squares; squares &= squares - 1)
+    {
+        int square = __builtin_ctzll(squares);
+        changes[count++] = {static_cast<uint8_t>(square), counts[1][square], counts[0][square], isHanging(square)};
+    }
+
+    dirty = 0;
+    return count;
+}
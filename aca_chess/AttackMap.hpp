@@ -0,0 +1,62 @@
+//
+//  AttackMap.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef AttackMap_hpp
+#define AttackMap_hpp
+
+#include "Board.hpp"
+
+#include <cstdint>
+
+struct SquareState
+{
+    uint8_t square;
+    uint8_t whiteAttackers;
+    uint8_t blackAttackers;
+    bool hanging;
+};
+
+// Which squares each side attacks and how often, kept up to date move by
+// move for display. Every square remembers the attack set of the piece on
+// it; a move only recomputes the squares it touched and the sliders whose
+// rays reach them. Squares whose state changed are collected until a client
+// takes them, so a view redraws only those.
+class AttackMap
+{
+    uint64_t from[64];          // squares attacked by the piece on each square
+    uint8_t counts[2][64];      // attackers per square, [0] black, [1] white
+    Piece occupant[64];
+    uint64_t whitePieces = 0;
+    uint64_t sliders = 0;
+    uint64_t dirty = 0;
+
+    void place(int square, Piece piece);
+    void remove(int square);
+    void add(int square, uint64_t occupancy);
+public:
+    AttackMap();
+
+    // Recomputes everything and marks every square changed
+    void reset(const Board& board);
+    // board is the position after move was made, or before it was taken back
+    void update(const Board& board, const Move& move);
+
+    uint64_t attacked(bool byWhite) const;
+    int attackers(int square, bool byWhite) const { return counts[byWhite][square]; }
+    uint64_t attackersOf(int square, bool byWhite) const;
+
+    // Pieces of the side that are attacked and either undefended or attacked
+    // by a less valuable piece
+    uint64_t hanging(bool white) const;
+    bool isHanging(int square) const;
+
+    // Writes the squares changed since the last call, at most 64, and
+    // returns how many were written
+    int takeChanges(SquareState* changes);
+};
+
+#endif /* AttackMap_hpp */
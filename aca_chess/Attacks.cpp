@@ -0,0 +1,244 @@
+//
+//  Attacks.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Attacks.hpp"
+#include "Cpu.hpp"
+
+#include <vector>
+
+#ifdef ACA_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct LeaperTables
+    {
+        uint64_t knight[64];
+        uint64_t king[64];
+        uint64_t pawn[2][64];
+
+        static uint64_t steps(int sq, const int (*offsets)[2], int count)
+        {
+            uint64_t result = 0;
+            for (int i = 0; i < count; i++)
+            {
+                int r = Attacks::row(sq) + offsets[i][0];
+                int c = Attacks::col(sq) + offsets[i][1];
+                if (r >= 0 && r < 8 && c >= 0 && c < 8)
+                    result |= 1ULL << Attacks::square(r, c);
+            }
+            return result;
+        }
+
+        LeaperTables()
+        {
+            const int knightSteps[8][2] = {
+                {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+            };
+            const int kingSteps[8][2] = {
+                {1, 1}, {1, 0}, {1, -1}, {0, 1}, {0, -1}, {-1, 1}, {-1, 0}, {-1, -1}
+            };
+            const int blackPawnSteps[2][2] = {{-1, 1}, {-1, -1}};
+            const int whitePawnSteps[2][2] = {{1, 1}, {1, -1}};
+
+            for (int sq = 0; sq < 64; sq++)
+            {
+                knight[sq] = steps(sq, knightSteps, 8);
+                king[sq] = steps(sq, kingSteps, 8);
+                pawn[0][sq] = steps(sq, blackPawnSteps, 2);
+                pawn[1][sq] = steps(sq, whitePawnSteps, 2);
+            }
+        }
+    };
+
+    const LeaperTables leapers;
+
+    uint64_t slide(int sq, uint64_t occupancy, const int (*directions)[2])
+    {
+        uint64_t result = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            int r = Attacks::row(sq) + directions[d][0];
+            int c = Attacks::col(sq) + directions[d][1];
+            while (r >= 0 && r < 8 && c >= 0 && c < 8)
+            {
+                uint64_t bit = 1ULL << Attacks::square(r, c);
+                result |= bit;
+                if (occupancy & bit)
+                    break;
+                r += directions[d][0];
+                c += directions[d][1];
+            }
+        }
+        return result;
+    }
+
+    const int rookDirections[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int bishopDirections[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+#ifdef ACA_X86_DISPATCH
+    // Multipliers that map the blockers of a square to distinct slots of a
+    // table of 2^bits entries, bits being the number of squares that can
+    // block. Found by trying sparse random numbers from a fixed seed.
+    const uint64_t rookMagics[64] = {
+        0x0100102040800100ULL, 0x0140024020001000ULL, 0x0200100840820020ULL, 0x2100082010010004ULL,
+        0x5880140080124800ULL, 0x4e0013040a007008ULL, 0x048001000a000080ULL, 0x820001822a004c01ULL,
+        0x4042800040008020ULL, 0x0884802005400080ULL, 0x182c801001802000ULL, 0x000a001009402202ULL,
+        0x0002800802040080ULL, 0x2002000410020008ULL, 0x0480800200800100ULL, 0x4001000060920100ULL,
+        0x0000808000400020ULL, 0x0090084000200040ULL, 0x0129010020001240ULL, 0x0028010100100020ULL,
+        0x008c050010080100ULL, 0x2000808002000401ULL, 0x0010140048023009ULL, 0x21104a0000840041ULL,
+        0x5000800080204000ULL, 0x6182200140005000ULL, 0x40e0008280100020ULL, 0x0041900280080080ULL,
+        0x0080040280080080ULL, 0x0020040080800200ULL, 0x0000810400088210ULL, 0x100c204200008124ULL,
+        0x2080084004802080ULL, 0x01c0100040c02000ULL, 0x004a021282002045ULL, 0x4800100822004200ULL,
+        0x0a00800400800802ULL, 0x0003040080800200ULL, 0x0800800200800100ULL, 0x0020004082000134ULL,
+        0x0040004080008020ULL, 0xc800500020084000ULL, 0x0088104200820021ULL, 0x0206024010220008ULL,
+        0x0002000409120020ULL, 0x1114000402008080ULL, 0x0090223021040008ULL, 0x0228085884020021ULL,
+        0x000540088000a880ULL, 0x00194004201000c0ULL, 0x0042104120010300ULL, 0x6810000800108080ULL,
+        0x8000510028000500ULL, 0x0a10020004008080ULL, 0x8000020110080400ULL, 0x6c01000062008100ULL,
+        0x00a3088002102441ULL, 0x6040188040002101ULL, 0xa400084020010011ULL, 0x0002210008051001ULL,
+        0xc612000904a01002ULL, 0x040a000821245002ULL, 0x0000021008008104ULL, 0x2802002910840042ULL
+    };
+
+    const uint64_t bishopMagics[64] = {
+        0x0002048128090100ULL, 0x4220440082004028ULL, 0x1012280e00204000ULL, 0x5084104202082004ULL,
+        0x0102021008004200ULL, 0x2031100210024620ULL, 0xc60218922030a14dULL, 0x0000442804100400ULL,
+        0x04a208204400d200ULL, 0x1126200801050434ULL, 0x0050040102220148ULL, 0x3010110400800220ULL,
+        0x1020011040520004ULL, 0x0000810120100420ULL, 0x2a094200a4a00804ULL, 0x22083602a4943000ULL,
+        0x0a2001c802300a00ULL, 0x08080210c1181080ULL, 0x4120480408002040ULL, 0x0010200802802002ULL,
+        0x8224080480a00000ULL, 0x9098400202502400ULL, 0xa108a00404010808ULL, 0x1001061024010400ULL,
+        0x342011003c910209ULL, 0x0602508020c40c80ULL, 0x0804900022002200ULL, 0x2801040080440080ULL,
+        0x0089004004044000ULL, 0x8020a60001080200ULL, 0x0004090000880100ULL, 0x0048604102010400ULL,
+        0x0010030840505088ULL, 0x021910b018981100ULL, 0x0104188802300240ULL, 0xa825042008040100ULL,
+        0x8060008400408020ULL, 0x0210010040080c00ULL, 0x4002880200144208ULL, 0x080c14008a002080ULL,
+        0x4804010440801000ULL, 0x80004410a4050826ULL, 0x0006804040400800ULL, 0x000042420080c800ULL,
+        0x0880081014001042ULL, 0x8b30200828410220ULL, 0x8020789200480080ULL, 0x00912214024c0100ULL,
+        0x000c024110080400ULL, 0x2101424c10880001ULL, 0x05000022011000a0ULL, 0x0818104084040000ULL,
+        0x00004004050c0078ULL, 0x3020080318020410ULL, 0x480410102a528006ULL, 0x0122040434104000ULL,
+        0x402204440a011010ULL, 0x0000228401880d40ULL, 0x0600100904061610ULL, 0x0002102000420200ULL,
+        0x0000108004050400ULL, 0xe05000322084a440ULL, 0x2053121428408401ULL, 0x0130200800908110ULL
+    };
+
+    // Attack sets for every blocker configuration, indexed by PEXT of the
+    // occupancy with the squares that can block. The tables are filled with
+    // a software deposit so building them needs no BMI2.
+    //
+    // CPUs with a microcoded PEXT use a second copy indexed by multiplying
+    // the blockers with a magic number instead.
+    struct SliderTable
+    {
+        uint64_t mask[64];
+        uint32_t offset[64];
+        uint64_t magic[64];
+        uint8_t shift[64];
+        std::vector<uint64_t> attacks;
+        std::vector<uint64_t> magicAttacks;
+
+        SliderTable(const int (*directions)[2], const uint64_t* magics)
+        {
+            for (int sq = 0; sq < 64; sq++)
+            {
+                // Edge squares never block anything behind them
+                mask[sq] = 0;
+                for (int d = 0; d < 4; d++)
+                {
+                    int r = Attacks::row(sq) + directions[d][0];
+                    int c = Attacks::col(sq) + directions[d][1];
+                    while (r + directions[d][0] >= 0 && r + directions[d][0] < 8 &&
+                           c + directions[d][1] >= 0 && c + directions[d][1] < 8)
+                    {
+                        mask[sq] |= 1ULL << Attacks::square(r, c);
+                        r += directions[d][0];
+                        c += directions[d][1];
+                    }
+                }
+
+                offset[sq] = static_cast<uint32_t>(attacks.size());
+                uint64_t subsets = 1ULL << __builtin_popcountll(mask[sq]);
+                for (uint64_t index = 0; index < subsets; index++)
+                    attacks.push_back(slide(sq, deposit(index, mask[sq]), directions));
+            }
+
+            // Every blocker subset lands in a slot that holds its attacks,
+            // subsets sharing a slot have equal attacks
+            magicAttacks.resize(attacks.size());
+            for (int sq = 0; sq < 64; sq++)
+            {
+                magic[sq] = magics[sq];
+                shift[sq] = static_cast<uint8_t>(64 - __builtin_popcountll(mask[sq]));
+
+                uint64_t subsets = 1ULL << __builtin_popcountll(mask[sq]);
+                for (uint64_t index = 0; index < subsets; index++)
+                {
+                    uint64_t slot = deposit(index, mask[sq]) * magic[sq] >> shift[sq];
+                    magicAttacks[offset[sq] + slot] = attacks[offset[sq] + index];
+                }
+            }
+        }
+
+        static uint64_t deposit(uint64_t bits, uint64_t mask)
+        {
+            uint64_t result = 0;
+            for (; mask; mask &= mask - 1, bits >>= 1)
+                if (bits & 1)
+                    result |= mask & -mask;
+            return result;
+        }
+
+        __attribute__((target("bmi2")))
+        uint64_t lookup(int sq, uint64_t occupancy) const
+        {
+            return attacks[offset[sq] + _pext_u64(occupancy, mask[sq])];
+        }
+
+        uint64_t magicLookup(int sq, uint64_t occupancy) const
+        {
+            return magicAttacks[offset[sq] + ((occupancy & mask[sq]) * magic[sq] >> shift[sq])];
+        }
+    };
+
+    const SliderTable rookTable(rookDirections, rookMagics);
+    const SliderTable bishopTable(bishopDirections, bishopMagics);
+#endif
+}
+
+uint64_t Attacks::knight(int square) noexcept
+{
+    return leapers.knight[square];
+}
+
+uint64_t Attacks::king(int square) noexcept
+{
+    return leapers.king[square];
+}
+
+uint64_t Attacks::pawn(int square, bool white) noexcept
+{
+    return leapers.pawn[white][square];
+}
+
+uint64_t Attacks::rook(int square, uint64_t occupancy) noexcept
+{
+#ifdef ACA_X86_DISPATCH
+    if (Cpu::usesPext())
+        return rookTable.lookup(square, occupancy);
+    if (Cpu::active() >= Cpu::Level::BMI2)
+        return rookTable.magicLookup(square, occupancy);
+#endif
+    return slide(square, occupancy, rookDirections);
+}
+
+uint64_t Attacks::bishop(int square, uint64_t occupancy) noexcept
+{
+#ifdef ACA_X86_DISPATCH
+    if (Cpu::usesPext())
+        return bishopTable.lookup(square, occupancy);
+    if (Cpu::active() >= Cpu::Level::BMI2)
+        return bishopTable.magicLookup(square, occupancy);
+#endif
+    return slide(square, occupancy, bishopDirections);
+}
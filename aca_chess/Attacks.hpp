@@ -0,0 +1,32 @@
+//
+//  Attacks.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Attacks_hpp
+#define Attacks_hpp
+
+#include <cstdint>
+
+// Attack sets on the Board bit layout, where square = row * 8 + (7 - col).
+namespace Attacks
+{
+    inline int square(int row, int col) noexcept { return row * 8 + (7 - col); }
+    inline int row(int square) noexcept { return square >> 3; }
+    inline int col(int square) noexcept { return 7 - (square & 7); }
+
+    uint64_t knight(int square) noexcept;
+    uint64_t king(int square) noexcept;
+    uint64_t pawn(int square, bool white) noexcept;   // squares a pawn on square captures
+
+    uint64_t rook(int square, uint64_t occupancy) noexcept;
+    uint64_t bishop(int square, uint64_t occupancy) noexcept;
+    inline uint64_t queen(int square, uint64_t occupancy) noexcept
+    {
+        return rook(square, occupancy) | bishop(square, occupancy);
+    }
+}
+
+#endif /* Attacks_hpp */
@@ -0,0 +1,235 @@
+//
+//  BatchAnalysis.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "BatchAnalysis.hpp"
+#include "Attacks.hpp"
+#include "Cpu.hpp"
+
+#ifdef ACA_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    enum Index
+    {
+        PAWN,
+        ROOK,
+        BISHOP,
+        KNIGHT,
+        QUEEN,
+        KING
+    };
+
+    uint64_t sideAttacks(const PositionBatch& batch, size_t i, bool white)
+    {
+        int base = white ? 0 : 6;
+        auto at = [&](int type) { return batch.pieces[base + type][i]; };
+
+        uint64_t occupancy = 0;
+        for (int p = 0; p < 12; p++)
+            occupancy |= batch.pieces[p][i];
+
+        uint64_t attacked = 0;
+        for (uint64_t pawns = at(PAWN); pawns; pawns &= pawns - 1)
+            attacked |= Attacks::pawn(__builtin_ctzll(pawns), white);
+        for (uint64_t knights = at(KNIGHT); knights; knights &= knights - 1)
+            attacked |= Attacks::knight(__builtin_ctzll(knights));
+        for (uint64_t kings = at(KING); kings; kings &= kings - 1)
+            attacked |= Attacks::king(__builtin_ctzll(kings));
+        for (uint64_t rooks = at(ROOK) | at(QUEEN); rooks; rooks &= rooks - 1)
+            attacked |= Attacks::rook(__builtin_ctzll(rooks), occupancy);
+        for (uint64_t bishops = at(BISHOP) | at(QUEEN); bishops; bishops &= bishops - 1)
+            attacked |= Attacks::bishop(__builtin_ctzll(bishops), occupancy);
+
+        return attacked;
+    }
+
+#ifdef ACA_X86_DISPATCH
+    // Columns run from bit 7 (a) down to bit 0 (h) within each row byte, so a
+    // step of (rows, cols) moves a bit by 8 * rows - cols. Bits that wrap into
+    // the neighbouring row land on the far files and are masked off.
+    constexpr uint64_t FILE_A = 0x8080808080808080ULL;
+    constexpr uint64_t FILE_B = 0x4040404040404040ULL;
+    constexpr uint64_t FILE_G = 0x0202020202020202ULL;
+    constexpr uint64_t FILE_H = 0x0101010101010101ULL;
+
+    constexpr uint64_t landing(int cols)
+    {
+        return cols == 1 ? ~FILE_A : cols == 2 ? ~(FILE_A | FILE_B) :
+               cols == -1 ? ~FILE_H : cols == -2 ? ~(FILE_G | FILE_H) : ~0ULL;
+    }
+
+    template <int SHIFT>
+    __attribute__((target("avx2")))
+    inline __m256i shift(__m256i v)
+    {
+        if constexpr (SHIFT > 0)
+            return _mm256_slli_epi64(v, SHIFT);
+        else
+            return _mm256_srli_epi64(v, -SHIFT);
+    }
+
+    template <int ROWS, int COLS>
+    __attribute__((target("avx2")))
+    inline __m256i step(__m256i v)
+    {
+        const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(landing(COLS)));
+        return _mm256_and_si256(shift<8 * ROWS - COLS>(v), mask);
+    }
+
+    // Kogge-Stone occluded fill: every slider on gen floods through empty
+    // squares in one direction in three doubling steps
+    template <int ROWS, int COLS>
+    __attribute__((target("avx2")))
+    inline __m256i slide(__m256i gen, __m256i empty)
+    {
+        constexpr int S = 8 * ROWS - COLS;
+        __m256i pro = _mm256_and_si256(empty, _mm256_set1_epi64x(static_cast<long long>(landing(COLS))));
+
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<S>(gen)));
+        pro = _mm256_and_si256(pro, shift<S>(pro));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<2 * S>(gen)));
+        pro = _mm256_and_si256(pro, shift<2 * S>(pro));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<4 * S>(gen)));
+
+        return step<ROWS, COLS>(gen);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i load(const PositionBatch& batch, int piece, size_t i)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(batch.pieces[piece].data() + i));
+    }
+
+    __attribute__((target("avx2")))
+    __m256i sideAttacks4(const PositionBatch& batch, size_t i, bool white, __m256i empty)
+    {
+        int base = white ? 0 : 6;
+        __m256i pawns = load(batch, base + PAWN, i);
+        __m256i knights = load(batch, base + KNIGHT, i);
+        __m256i kings = load(batch, base + KING, i);
+        __m256i queens = load(batch, base + QUEEN, i);
+        __m256i rooks = _mm256_or_si256(load(batch, base + ROOK, i), queens);
+        __m256i bishops = _mm256_or_si256(load(batch, base + BISHOP, i), queens);
+
+        __m256i attacked = white ? _mm256_or_si256(step<1, 1>(pawns), step<1, -1>(pawns))
+                                 : _mm256_or_si256(step<-1, 1>(pawns), step<-1, -1>(pawns));
+
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<1, 2>(knights), step<1, -2>(knights)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<-1, 2>(knights), step<-1, -2>(knights)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<2, 1>(knights), step<2, -1>(knights)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<-2, 1>(knights), step<-2, -1>(knights)));
+
+        __m256i row = _mm256_or_si256(kings, _mm256_or_si256(step<0, 1>(kings), step<0, -1>(kings)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<0, 1>(kings), step<0, -1>(kings)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(step<1, 0>(row), step<-1, 0>(row)));
+
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(slide<1, 0>(rooks, empty), slide<-1, 0>(rooks, empty)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(slide<0, 1>(rooks, empty), slide<0, -1>(rooks, empty)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(slide<1, 1>(bishops, empty), slide<1, -1>(bishops, empty)));
+        attacked = _mm256_or_si256(attacked, _mm256_or_si256(slide<-1, 1>(bishops, empty), slide<-1, -1>(bishops, empty)));
+
+        return attacked;
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i empty4(const PositionBatch& batch, size_t i)
+    {
+        __m256i occupancy = _mm256_setzero_si256();
+        for (int p = 0; p < 12; p++)
+            occupancy = _mm256_or_si256(occupancy, load(batch, p, i));
+        return _mm256_xor_si256(occupancy, _mm256_set1_epi64x(-1));
+    }
+
+    __attribute__((target("avx2")))
+    size_t attacksAvx2(const PositionBatch& batch, bool byWhite, uint64_t* attacked)
+    {
+        size_t i = 0;
+        for (; i + 4 <= batch.size(); i += 4)
+        {
+            __m256i result = sideAttacks4(batch, i, byWhite, empty4(batch, i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(attacked + i), result);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    size_t inCheckAvx2(const PositionBatch& batch, uint8_t* check)
+    {
+        size_t i = 0;
+        for (; i + 4 <= batch.size(); i += 4)
+        {
+            __m256i empty = empty4(batch, i);
+            __m256i whiteInCheck = _mm256_and_si256(load(batch, KING, i), sideAttacks4(batch, i, false, empty));
+            __m256i blackInCheck = _mm256_and_si256(load(batch, 6 + KING, i), sideAttacks4(batch, i, true, empty));
+
+            int32_t sides;
+            __builtin_memcpy(&sides, batch.whiteToMove.data() + i, sizeof(sides));
+            __m256i white = _mm256_cmpgt_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(sides)), _mm256_setzero_si256());
+
+            __m256i threatened = _mm256_blendv_epi8(blackInCheck, whiteInCheck, white);
+            __m256i safe = _mm256_cmpeq_epi64(threatened, _mm256_setzero_si256());
+            int safeMask = _mm256_movemask_pd(_mm256_castsi256_pd(safe));
+
+            for (int lane = 0; lane < 4; lane++)
+                check[i + lane] = !(safeMask >> lane & 1);
+        }
+        return i;
+    }
+#endif
+}
+
+void PositionBatch::clear()
+{
+    for (auto& bitboards : pieces)
+        bitboards.clear();
+    whiteToMove.clear();
+}
+
+void PositionBatch::push(const Board& board)
+{
+    for (int p = 0; p < 12; p++)
+        pieces[p].push_back(board.getBitboard(static_cast<Piece>(p + 1)));
+    whiteToMove.push_back(board.isWhiteToMove());
+}
+
+void BatchAnalysis::attacksReference(const PositionBatch& batch, bool byWhite, uint64_t* attacked, size_t begin)
+{
+    for (size_t i = begin; i < batch.size(); i++)
+        attacked[i] = sideAttacks(batch, i, byWhite);
+}
+
+void BatchAnalysis::inCheckReference(const PositionBatch& batch, uint8_t* check, size_t begin)
+{
+    for (size_t i = begin; i < batch.size(); i++)
+    {
+        bool white = batch.whiteToMove[i];
+        uint64_t king = batch.pieces[(white ? 0 : 6) + KING][i];
+        check[i] = (king & sideAttacks(batch, i, !white)) != 0;
+    }
+}
+
+void BatchAnalysis::attacks(const PositionBatch& batch, bool byWhite, uint64_t* attacked)
+{
+    size_t done = 0;
+#ifdef ACA_X86_DISPATCH
+    if (Cpu::active() >= Cpu::Level::AVX2)
+        done = attacksAvx2(batch, byWhite, attacked);
+#endif
+    attacksReference(batch, byWhite, attacked, done);
+}
+
+void BatchAnalysis::inCheck(const PositionBatch& batch, uint8_t* check)
+{
+    size_t done = 0;
+#ifdef ACA_X86_DISPATCH
+    if (Cpu::active() >= Cpu::Level::AVX2)
+        done = inCheckAvx2(batch, check);
+#endif
+    inCheckReference(batch, check, done);
+}
@@ -0,0 +1,45 @@
+//
+//  BatchAnalysis.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef BatchAnalysis_hpp
+#define BatchAnalysis_hpp
+
+#include "Board.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Many positions in structure-of-arrays form: pieces[p - 1][i] is the
+// bitboard of Piece p in position i, so the same bitboard of consecutive
+// positions is contiguous and loads straight into a vector register.
+struct PositionBatch
+{
+    std::vector<uint64_t> pieces[12];
+    std::vector<uint8_t> whiteToMove;
+
+    size_t size() const { return whiteToMove.size(); }
+    void clear();
+    void push(const Board& board);
+};
+
+// Attack sets and check status for whole batches. With AVX2 four positions
+// are processed per register and sliders use Kogge-Stone fills; otherwise,
+// and for the tail of a batch, positions go one at a time through Attacks.
+namespace BatchAnalysis
+{
+    // attacked[i] holds the squares the given side attacks in position i
+    void attacks(const PositionBatch& batch, bool byWhite, uint64_t* attacked);
+    // check[i] is 1 when the side to move in position i is in check
+    void inCheck(const PositionBatch& batch, uint8_t* check);
+
+    // Scalar reference versions, one position at a time
+    void attacksReference(const PositionBatch& batch, bool byWhite, uint64_t* attacked, size_t begin = 0);
+    void inCheckReference(const PositionBatch& batch, uint8_t* check, size_t begin = 0);
+}
+
+#endif /* BatchAnalysis_hpp */
@@ -0,0 +1,567 @@
+//
+//  Benchmark.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Benchmark.hpp"
+#include "AttackMap.hpp"
+#include "Attacks.hpp"
+#include "BatchAnalysis.hpp"
+#include "Game.hpp"
+#include "Cpu.hpp"
+#include "PackedPosition.hpp"
+#include "Search.hpp"
+#include "TranspositionTable.hpp"
+#include "Zobrist.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace
+{
+    template <typename F>
+    double seconds(F&& body)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const char* name, double count, double elapsed, const char* unit)
+    {
+        std::cout << "  " << name << ": " << count / elapsed / 1e6 << " M " << unit << "/s" << std::endl;
+    }
+
+    int benchPacking()
+    {
+        const size_t count = 1 << 20;
+        std::vector<Board> boards = Benchmark::samplePositions(count);
+        std::vector<PackedPosition> packed(count);
+        std::vector<Board> unpacked(count);
+
+        size_t converted = 0, restored = 0;
+        report("pack", count, seconds([&] { converted = packPositions(boards.data(), packed.data(), count); }), "positions");
+        report("unpack", count, seconds([&] { restored = unpackPositions(packed.data(), unpacked.data(), count); }), "positions");
+
+        int failures = static_cast<int>(2 * count - converted - restored);
+        for (size_t i = 0; i < count; i++)
+            failures += !(boards[i] == unpacked[i]);
+
+        // Corrupt piece codes must be rejected rather than index past the bitboards
+        Board scratch;
+        for (uint8_t code : {0, 13, 14, 15})
+        {
+            PackedPosition corrupt = packed[0];
+            corrupt.pieces[0] = static_cast<uint8_t>((corrupt.pieces[0] & 0xf0) | code);
+            failures += corrupt.unpack(scratch);
+        }
+
+        return failures;
+    }
+
+    // Searches the same positions with both backends; they must agree on every
+    // result since they walk the same tree
+    int benchSearch()
+    {
+        const size_t count = 100;
+        std::vector<Board> boards = Benchmark::samplePositions(count, 7);
+        SearchLimits limits;
+        limits.depth = 4;
+
+        // Each backend runs without and then with a transposition table, which
+        // is what feeds the hash stage of the move picker
+        const SearchBackend backends[2] = {SearchBackend::MAKE_UNMAKE, SearchBackend::COPY_MAKE};
+        const char* names[4] = {"make/unmake", "copy-make", "make/unmake with table", "copy-make with table"};
+        std::vector<SearchResult> results[4];
+
+        for (int run = 0; run < 4; run++)
+        {
+            Search search;
+            TranspositionTable table(1 << 16);
+            if (run >= 2)
+                search.setTable(&table);
+
+            uint64_t nodes = 0;
+            double elapsed = seconds([&] {
+                for (const Board& board : boards)
+                {
+                    // Every position starts empty, so the table cannot leak deeper results into the next
+                    table.clear();
+                    results[run].push_back(search.run(board, limits, backends[run % 2]));
+                    nodes += results[run].back().nodes;
+                }
+            });
+            report(names[run], static_cast<double>(nodes), elapsed, "nodes");
+        }
+
+        // Where the moves that were searched and the cutoffs came from
+        const char* stages[PICK_STAGES] = {"hash", "captures", "killers", "quiets"};
+        for (int run = 0; run < 4; run += 2)
+        {
+            uint64_t moves[PICK_STAGES] = {}, cutoffs[PICK_STAGES] = {};
+            for (const SearchResult& result : results[run])
+                for (int s = 0; s < PICK_STAGES; s++)
+                {
+                    moves[s] += result.stageMoves[s];
+                    cutoffs[s] += result.stageCutoffs[s];
+                }
+
+            std::cout << "  " << (run ? "with table" : "without table") << std::endl;
+            for (int s = 0; s < PICK_STAGES; s++)
+                std::cout << "    " << stages[s] << ": " << moves[s] << " moves, " << cutoffs[s] << " cutoffs" << std::endl;
+        }
+
+        int failures = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int run = 0; run < 4; run += 2)
+            {
+                const SearchResult& a = results[run][i];
+                const SearchResult& b = results[run + 1][i];
+                failures += a.nodes != b.nodes || a.score != b.score || a.best.pack() != b.best.pack();
+                for (int s = 0; s < PICK_STAGES; s++)
+                    failures += a.stageMoves[s] != b.stageMoves[s] || a.stageCutoffs[s] != b.stageCutoffs[s];
+            }
+
+            // The table may make the search cheaper but must not change its result
+            failures += results[0][i].score != results[2][i].score;
+
+            Position position;
+            Board board;
+            Position::fromBoard(boards[i], position);
+            position.toBoard(board);
+            failures += !(board == boards[i]);
+        }
+
+        return failures;
+    }
+
+    // Runs the slider and evaluation kernels of every level this CPU supports;
+    // their checksums must match the scalar ones
+    int benchKernels()
+    {
+        const size_t count = 1 << 16;
+        std::vector<Board> boards = Benchmark::samplePositions(count, 11);
+        std::vector<uint64_t> occupancies(count);
+        for (size_t i = 0; i < count; i++)
+            occupancies[i] = boards[i].getBitboard(Piece::WHITEPAWN) | boards[i].getBitboard(Piece::BLACKPAWN) |
+                             boards[i].getBitboard(Piece::WHITEKNIGHT) | boards[i].getBitboard(Piece::BLACKKNIGHT) |
+                             boards[i].getBitboard(Piece::WHITEKING) | boards[i].getBitboard(Piece::BLACKKING);
+
+        Cpu::Level original = Cpu::active();
+        uint64_t expectedSliders = 0;
+        int64_t expectedEval = 0;
+        int failures = 0;
+
+        for (Cpu::Level level : {Cpu::Level::SCALAR, Cpu::Level::POPCNT, Cpu::Level::BMI2, Cpu::Level::AVX2})
+        {
+            if (!Cpu::setActive(level))
+                break;
+            std::cout << "  " << Cpu::name(level) << std::endl;
+
+            // From BMI2 on the sliders run both with PEXT and with magic indexing
+            uint64_t sliders = 0;
+            bool preferred = Cpu::pextPreferred;
+            for (bool pext : {true, false})
+            {
+                if (!pext && level < Cpu::Level::BMI2)
+                    break;
+                Cpu::pextPreferred = pext;
+
+                uint64_t sum = 0;
+                const char* label = level < Cpu::Level::BMI2 ? "  sliders" : pext ? "  sliders pext" : "  sliders magic";
+                report(label, count * 64.0, seconds([&] {
+                    for (uint64_t occupancy : occupancies)
+                        for (int sq = 0; sq < 64; sq++)
+                            sum += Attacks::rook(sq, occupancy) ^ Attacks::bishop(sq, occupancy);
+                }), "squares");
+
+                failures += pext ? 0 : sum != sliders;
+                sliders = sum;
+            }
+            Cpu::pextPreferred = preferred;
+
+            int64_t eval = 0;
+            report("  evaluate", count * 16.0, seconds([&] {
+                for (int repeat = 0; repeat < 16; repeat++)
+                    for (const Board& board : boards)
+                        eval += Search::evaluate(board);
+            }), "positions");
+
+            if (level == Cpu::Level::SCALAR)
+            {
+                expectedSliders = sliders;
+                expectedEval = eval;
+            }
+            failures += (sliders != expectedSliders) + (eval != expectedEval);
+        }
+
+        Cpu::setActive(original);
+        return failures;
+    }
+
+    // The batch kernels against their one-position-at-a-time reference, and
+    // the check flags against Board::inCheck
+    int benchBatch()
+    {
+        const size_t count = 1 << 18;
+        std::vector<Board> boards = Benchmark::samplePositions(count, 5);
+        PositionBatch batch;
+        for (const Board& board : boards)
+            batch.push(board);
+
+        std::vector<uint64_t> reference(count), batched(count);
+        std::vector<uint8_t> referenceCheck(count), batchedCheck(count);
+
+        std::cout << "  " << Cpu::name(Cpu::active()) << std::endl;
+        report("reference attacks", count, seconds([&] { BatchAnalysis::attacksReference(batch, true, reference.data()); }), "positions");
+        report("batch attacks", count, seconds([&] { BatchAnalysis::attacks(batch, true, batched.data()); }), "positions");
+        report("reference check", count, seconds([&] { BatchAnalysis::inCheckReference(batch, referenceCheck.data()); }), "positions");
+        report("batch check", count, seconds([&] { BatchAnalysis::inCheck(batch, batchedCheck.data()); }), "positions");
+
+        int failures = 0;
+        for (size_t i = 0; i < count; i++)
+            failures += (reference[i] != batched[i]) + (referenceCheck[i] != batchedCheck[i]) +
+                        (batchedCheck[i] != boards[i].inCheck());
+
+        BatchAnalysis::attacksReference(batch, false, reference.data());
+        BatchAnalysis::attacks(batch, false, batched.data());
+        for (size_t i = 0; i < count; i++)
+            failures += reference[i] != batched[i];
+
+        return failures;
+    }
+
+    // Follows random games move by move and takes every move back again; the
+    // incremental map must always equal one rebuilt from scratch
+    int benchAttackMap()
+    {
+        const int games = 2000;
+        std::mt19937_64 rng(9);
+        std::vector<Board> boards;
+        std::vector<Move> moves;
+
+        Board board;
+        for (int game = 0; game < games; game++, board = Board())
+        {
+            for (int ply = 0; ply < 100; ply++)
+            {
+                MoveList legal;
+                board.legalMoves(legal);
+                if (legal.count == 0)
+                    break;
+
+                moves.push_back(legal.moves[rng() % legal.count]);
+                board.makeMove(moves.back());
+                boards.push_back(board);
+            }
+            moves.push_back(Move{});
+            boards.push_back(Board());
+        }
+
+        AttackMap incremental;
+        SquareState changes[64];
+        size_t changed = 0;
+        report("incremental", static_cast<double>(moves.size()), seconds([&] {
+            for (size_t i = 0; i < moves.size(); i++)
+            {
+                if (moves[i].from == moves[i].to)
+                    incremental.reset(boards[i]);
+                else
+                    incremental.update(boards[i], moves[i]);
+                changed += incremental.takeChanges(changes);
+            }
+        }), "moves");
+        std::cout << "  " << static_cast<double>(changed) / moves.size() << " changed squares per move" << std::endl;
+
+        AttackMap rebuilt;
+        report("rebuild", static_cast<double>(moves.size()), seconds([&] {
+            for (const Board& position : boards)
+                rebuilt.reset(position);
+        }), "moves");
+
+        int failures = 0;
+        auto compare = [&](const AttackMap& a, const AttackMap& b) {
+            bool same = a.hanging(true) == b.hanging(true) && a.hanging(false) == b.hanging(false);
+            for (int square = 0; square < 64; square++)
+                same = same && a.attackers(square, true) == b.attackers(square, true) &&
+                       a.attackers(square, false) == b.attackers(square, false);
+            failures += !same;
+        };
+
+        // A view that only applies the reported changes must end up showing
+        // the rebuilt map, so no changed square may be left out
+        SquareState view[64];
+        auto follow = [&](AttackMap& map) {
+            int count = map.takeChanges(changes);
+            for (int i = 0; i < count; i++)
+                view[changes[i].square] = changes[i];
+        };
+        auto compareView = [&](const AttackMap& expected) {
+            bool same = true;
+            for (int square = 0; square < 64; square++)
+                same = same && view[square].whiteAttackers == expected.attackers(square, true) &&
+                       view[square].blackAttackers == expected.attackers(square, false) &&
+                       view[square].hanging == expected.isHanging(square);
+            failures += !same;
+        };
+
+        // Every position forward, then the takebacks of the first game
+        incremental.reset(Board());
+        follow(incremental);
+        for (size_t i = 0; i < moves.size(); i++)
+        {
+            if (moves[i].from == moves[i].to)
+            {
+                incremental.reset(boards[i]);
+                follow(incremental);
+                continue;
+            }
+
+            incremental.update(boards[i], moves[i]);
+            follow(incremental);
+            rebuilt.reset(boards[i]);
+            compare(incremental, rebuilt);
+            compareView(rebuilt);
+        }
+
+        board = Board();
+        std::vector<UndoInfo> undos;
+        incremental.reset(board);
+        follow(incremental);
+        for (size_t i = 0; moves[i].from != moves[i].to; i++)
+        {
+            undos.emplace_back();
+            board.makeMove(moves[i], undos.back());
+            incremental.update(board, moves[i]);
+            follow(incremental);
+        }
+        for (size_t i = undos.size(); i-- > 0;)
+        {
+            board.unmakeMove(moves[i], undos[i]);
+            incremental.update(board, moves[i]);
+            follow(incremental);
+            rebuilt.reset(board);
+            compare(incremental, rebuilt);
+            compareView(rebuilt);
+        }
+
+        return failures;
+    }
+
+    // Zobrist keys must follow the Polyglot layout: the built-in table survives
+    // a round trip through the loader and the reference positions published
+    // with the format get their known keys
+    int benchKeys()
+    {
+        struct Reference
+        {
+            const char* moves;
+            uint64_t key;
+        };
+        const Reference references[] = {
+            {"", 0x463b96181691fc9cULL},
+            {"e2e4", 0x823c9b50fd114196ULL},
+            {"e2e4 d7d5", 0x0756b94461c50fb0ULL},
+            {"e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL},
+            {"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL},
+            {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL},
+            {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL},
+            {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL},
+            {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL},
+        };
+
+        int failures = 0;
+        uint64_t before = Zobrist::polyglotKey(Board());
+
+        // The active table written back in the Polyglot file format
+        const Piece kinds[12] = {Piece::BLACKPAWN, Piece::WHITEPAWN, Piece::BLACKKNIGHT, Piece::WHITEKNIGHT,
+                                 Piece::BLACKBISHOP, Piece::WHITEBISHOP, Piece::BLACKROOK, Piece::WHITEROOK,
+                                 Piece::BLACKQUEEN, Piece::WHITEQUEEN, Piece::BLACKKING, Piece::WHITEKING};
+        const char* directory = std::getenv("TMPDIR");
+        std::string path = std::string(directory ? directory : "/tmp") + "/aca-keys.bin";
+        {
+            std::ofstream out(path, std::ios::binary);
+            for (int i = 0; i < Zobrist::KEY_COUNT; i++)
+            {
+                uint64_t key = i < Zobrist::CASTLE_OFFSET ? Zobrist::pieceKey(kinds[i / 64], (i % 64) ^ 7)
+                             : i < Zobrist::EN_PASSANT_OFFSET ? Zobrist::castlingKey(i - Zobrist::CASTLE_OFFSET)
+                             : i < Zobrist::TURN_OFFSET ? Zobrist::enPassantKey(i - Zobrist::EN_PASSANT_OFFSET)
+                             : Zobrist::turnKey();
+                for (int b = 7; b >= 0; b--)
+                    out.put(static_cast<char>(key >> (b * 8)));
+            }
+        }
+
+        bool accepted = Zobrist::loadPolyglotTable(path.c_str());
+        std::remove(path.c_str());
+
+        failures += !accepted;
+        failures += Zobrist::polyglotKey(Board()) != before;
+
+        for (const Reference& reference : references)
+        {
+            Board board;
+            char text[8];
+            for (const char* move = reference.moves; *move; move += *move == ' ')
+            {
+                int length = 0;
+                while (move[length] && move[length] != ' ')
+                    length++;
+                std::memcpy(text, move, length);
+                text[length] = 0;
+                move += length;
+
+                Move parsed;
+                failures += !board.parseMove(text, parsed);
+                board.makeMove(parsed);
+            }
+            failures += Zobrist::polyglotKey(board) != reference.key;
+        }
+
+        return failures;
+    }
+
+    // Navigates a long game with a side variation; every position reached
+    // must equal the one played over the board
+    int benchHistory()
+    {
+        std::mt19937_64 rng(13);
+        Game game;
+        std::vector<Board> line{game.getBoard()};
+
+        while (line.size() <= 300)
+        {
+            MoveList legal;
+            game.getBoard().legalMoves(legal);
+            if (legal.count == 0)
+            {
+                game.start(Board());
+                line.assign(1, game.getBoard());
+                continue;
+            }
+
+            game.play(legal.moves[rng() % legal.count]);
+            line.push_back(game.getBoard());
+        }
+
+        int failures = 0;
+        const int plies = static_cast<int>(line.size()) - 1;
+
+        // A variation from the middle of the game, then back to the main line
+        uint32_t end = game.getHistory().currentNode();
+        game.jumpToPly(plies / 2);
+        MoveList legal;
+        game.getBoard().legalMoves(legal);
+        game.play(legal.moves[legal.count - 1]);
+        game.play(legal.moves[0]);
+        game.takeback();
+        game.goTo(end);
+        failures += !(game.getBoard() == line[plies]);
+
+        const int steps = 100000;
+        std::vector<int> targets(steps);
+        for (int& target : targets)
+            target = static_cast<int>(rng() % (plies + 1));
+
+        report("takeback+redo", 2.0 * steps, seconds([&] {
+            for (int i = 0; i < steps; i++)
+            {
+                game.takeback();
+                game.redo();
+            }
+        }), "steps");
+
+        double elapsed = seconds([&] {
+            for (int target : targets)
+                game.jumpToPly(target);
+        });
+        report("jump", steps, elapsed, "jumps");
+        std::cout << "  " << elapsed / steps * 1e6 << " us per jump over " << plies << " plies" << std::endl;
+
+        for (int i = 0; i < 1000; i++)
+        {
+            game.jumpToPly(targets[i]);
+            failures += !(game.getBoard() == line[targets[i]]);
+        }
+
+        for (int ply = plies; ply > 0; ply--)
+        {
+            game.jumpToPly(ply);
+            game.takeback();
+            failures += !(game.getBoard() == line[ply - 1]);
+        }
+
+        return failures;
+    }
+
+    struct Entry
+    {
+        const char* name;
+        int (*body)();
+    };
+
+    const Entry benchmarks[] = {
+        {"packing", benchPacking},
+        {"search", benchSearch},
+        {"kernels", benchKernels},
+        {"batch", benchBatch},
+        {"attackmap", benchAttackMap},
+        {"history", benchHistory},
+        {"keys", benchKeys},
+    };
+}
+
+std::vector<Board> Benchmark::samplePositions(size_t count, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<Board> positions;
+    positions.reserve(count);
+
+    Board board;
+    int ply = 0;
+    while (positions.size() < count)
+    {
+        MoveList legal;
+        board.legalMoves(legal);
+
+        if (legal.count == 0 || ply >= 120)
+        {
+            board = Board();
+            ply = 0;
+            continue;
+        }
+
+        board.makeMove(legal.moves[rng() % legal.count]);
+        positions.push_back(board);
+        ply++;
+    }
+
+    return positions;
+}
+
+int Benchmark::run(const char* filter)
+{
+    int failures = 0;
+
+    for (const Entry& entry : benchmarks)
+    {
+        if (filter && !std::strstr(entry.name, filter))
+            continue;
+
+        std::cout << entry.name << std::endl;
+        int failed = entry.body();
+        if (failed)
+            std::cout << "  FAILED: " << failed << " inconsistent results" << std::endl;
+        failures += failed;
+    }
+
+    return failures;
+}
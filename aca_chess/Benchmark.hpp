@@ -0,0 +1,26 @@
+//
+//  Benchmark.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+#include "Board.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Benchmark
+{
+    // Reproducible positions reached by random playouts from the start position
+    std::vector<Board> samplePositions(size_t count, uint64_t seed = 1);
+
+    // Runs every benchmark whose name contains filter (all when filter is null)
+    // and returns the number of failed consistency checks
+    int run(const char* filter);
+}
+
+#endif /* Benchmark_hpp */
@@ -6,8 +6,13 @@
 //
 
 #include "Board.hpp"
+#include "Attacks.hpp"
+#include "Invariants.hpp"
+#include "Zobrist.hpp"
 
 #include <cmath>
+#include <cstring>
+#include <sstream>
 #include <vector>
 #include <future>
 
@@ -28,7 +33,7 @@ Board::Board()
     positionBlackKing = positionWhiteKing << 56;
 }
 
-uint64_t& Board::getEncoding(Piece piece)
+uint64_t& Board::getEncoding(Piece piece) noexcept
 {
     switch (piece)
     {
@@ -59,10 +64,40 @@ uint64_t& Board::getEncoding(Piece piece)
         default:
             break;
     }
-    throw std::invalid_argument("The argument piece is Piece::NONE");
+    
+    // Piece::NONE owns no squares: it reads as empty and writes to it are dropped
+    static thread_local uint64_t none;
+    none = 0;
+    return none;
+}
+
+uint64_t Board::getBitboard(Piece piece) const noexcept
+{
+    if (piece == Piece::NONE)
+        return 0;
+    
+    return const_cast<Board*>(this)->getEncoding(piece);
 }
 
-void Board::__set(int row, int col, Piece piece)
+void Board::__updateCastlingRights()
+{
+    // A right survives only while its king and rook still stand on their home squares
+    if (get(0, 4) != Piece::WHITEKING)
+        castlingRights &= ~(WHITE_OO | WHITE_OOO);
+    if (get(0, 7) != Piece::WHITEROOK)
+        castlingRights &= ~WHITE_OO;
+    if (get(0, 0) != Piece::WHITEROOK)
+        castlingRights &= ~WHITE_OOO;
+    
+    if (get(7, 4) != Piece::BLACKKING)
+        castlingRights &= ~(BLACK_OO | BLACK_OOO);
+    if (get(7, 7) != Piece::BLACKROOK)
+        castlingRights &= ~BLACK_OO;
+    if (get(7, 0) != Piece::BLACKROOK)
+        castlingRights &= ~BLACK_OOO;
+}
+
+void Board::__set(int row, int col, Piece piece) noexcept
 {
     Piece p = get(row, col);
     if (p != Piece::NONE)
@@ -80,21 +115,18 @@ int Board::evaluateBoard()
     return static_cast<int>(isMate());
 }
 
-void Board::set(Coordinate coord, Piece piece)
+bool Board::set(Coordinate coord, Piece piece)
 {
     char col = coord.col;
     uint8_t row = coord.row;
     
     if (row < 1 || row > 8 || col < 'a' || col > 'h')
-        throw std::invalid_argument{"Error: invalid values for row or column!"};
+        return false;
     
     __set(row - 1, col - 'a', piece);
-    
-    for (int i = 0; i < 10; i++)
-        std::cout << "\n";
-    draw();
-    std::cout << "\n";
-    std::cout << "\n";
+    __updateCastlingRights();
+    enPassantCol = -1;
+    return true;
 }
 
 //int Board::minimax(int depth, bool isMaximizingPlayer) {
@@ -262,7 +294,7 @@ int Board::minimax(int depth, bool isMaximizingPlayer) {
 }
 
 
-Piece Board::get(int row, int col) const
+Piece Board::get(int row, int col) const noexcept
 {
     unsigned long long mask = 1ULL << (row * 8 + (7 - col));
     
@@ -385,7 +417,7 @@ Piece Board::get(int row, int col) const
 //    return false;
 //}
 
-bool Board::isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo) {
+bool Board::isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo) const {
     Piece p = get(rowFrom, colFrom);
     Piece target = get(rowTo, colTo);
 
@@ -504,20 +536,19 @@ bool Board::isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo) {
             return false;
     }
 
-    // If the move is valid based on the piece's rules, check if it leaves the king in check
+    // If the move is valid based on the piece's rules, check if it leaves the king in check.
+    // The position after the move is described by its occupancy, nothing is modified
     if (validMove) {
-        // Temporarily make the move
-        __set(rowTo, colTo, p);
-        __set(rowFrom, colFrom, Piece::NONE);
-
-        bool kingInCheck = isWhite ? isAttackWhite() : isAttackBlack();
+        uint64_t fromBit = 1ULL << Attacks::square(rowFrom, colFrom);
+        uint64_t toBit = 1ULL << Attacks::square(rowTo, colTo);
+        uint64_t occupancy = ((__whitePieces() | __blackPieces()) & ~fromBit) | toBit;
 
-        // Revert the move
-        __set(rowFrom, colFrom, p);
-        __set(rowTo, colTo, target);
+        uint64_t king = isWhite ? positionWhiteKing : positionBlackKing;
+        if (p == Piece::WHITEKING || p == Piece::BLACKKING)
+            king = toBit;
 
         // If the king is in check after the move, the move is invalid
-        if (kingInCheck)
+        if (king && __isSquareAttacked(__builtin_ctzll(king), !isWhite, occupancy, toBit))
             return false;
 
         return true;
@@ -531,8 +562,6 @@ bool Board::isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo) {
 
 bool Board::__move(int rowFrom, int colFrom, int rowTo, int colTo)
 {
-    std::cout << std::endl;
-    
     if (isMoveValid(rowFrom, colFrom, rowTo, colTo))
     {
         Piece p = get(rowFrom, colFrom);
@@ -540,8 +569,6 @@ bool Board::__move(int rowFrom, int colFrom, int rowTo, int colTo)
         __set(rowTo, colTo, p);
         __set(rowFrom, colFrom, Piece::NONE);
         
-        draw();
-        
         return true;
     }
     
@@ -555,7 +582,18 @@ bool Board::move(Coordinate fromCoord, Coordinate toCoord)
     int rowTo = toCoord.row - 1;
     int colTo = toCoord.col - 'a';
 
-    return __move(rowFrom, colFrom, rowTo, colTo);
+    Piece p = get(rowFrom, colFrom);
+    if (!__move(rowFrom, colFrom, rowTo, colTo))
+        return false;
+    
+    // Only moves played through the public interface advance the game state,
+    // the search keeps using __move/__set and tracks the side on its own
+    bool isPawn = p == Piece::WHITEPAWN || p == Piece::BLACKPAWN;
+    enPassantCol = (isPawn && std::abs(rowTo - rowFrom) == 2) ? colFrom : -1;
+    __updateCastlingRights();
+    whiteToMove = (int)p > (int)Piece::WHITEKING;
+    
+    return true;
 }
 
 //void Board::draw()
@@ -678,61 +716,17 @@ void Board::draw()
 }
 
 
-bool Board::isAttackBlack()
+bool Board::isAttackBlack() const noexcept
 {
-    int bKingPos = (int)log2(positionBlackKing);
-    int bKingRow = bKingPos >> 3;
-    int bKingCol = 8 - (bKingPos + 1) & 7;
-//    int bKingCol = 8 - (bKingPos + 1) % 8;
-
-    uint64_t allWhitePieces = positionWhitePawn | positionWhiteRook | positionWhiteBishop |
-                              positionWhiteKnight | positionWhiteQueen | positionWhiteKing;
-
-//    std::cout << std::bitset<64>(allWhitePieces) << std::endl;
-    
-    while (allWhitePieces)
-    {
-        int pos = (int)log2(allWhitePieces & -allWhitePieces);
-        int row = pos >> 3;
-        int col = 8 - (pos + 1) & 7;
-
-        if (isMoveValid(row, col, bKingRow, bKingCol))
-            return true;
-
-        allWhitePieces &= allWhitePieces - 1;
-    }
-
-    return false;
+    return positionBlackKing && isSquareAttacked(__builtin_ctzll(positionBlackKing), true);
 }
 
-bool Board::isAttackWhite()
+bool Board::isAttackWhite() const noexcept
 {
-    int bKingPos = (int)log2(positionWhiteKing);
-    int bKingRow = bKingPos >> 3;
-    int bKingCol = 8 - (bKingPos + 1) & 7;
-//    int bKingCol = 8 - (bKingPos + 1) % 8;
-
-    uint64_t allBlackPieces = positionBlackPawn | positionBlackRook | positionBlackBishop |
-                              positionBlackKnight | positionBlackQueen | positionBlackKing;
-
-//    std::cout << std::bitset<64>(allBlackPieces) << std::endl;
-    
-    while (allBlackPieces)
-    {
-        int pos = (int)log2(allBlackPieces & -allBlackPieces);
-        int row = pos >> 3;
-        int col = 8 - (pos + 1) & 7;
-
-        if (isMoveValid(row, col, bKingRow, bKingCol))
-            return true;
-
-        allBlackPieces &= allBlackPieces - 1;
-    }
-
-    return false;
+    return positionWhiteKing && isSquareAttacked(__builtin_ctzll(positionWhiteKing), false);
 }
 
-int Board::isAttack()
+int Board::isAttack() const
 {
     if (isAttackWhite())
         return -1;
@@ -795,10 +789,10 @@ int Board::isMate() {
 
     if (attackStatus == 1) {  // White is attacking Black's King
         kingPiece = Piece::BLACKKING;
-        kingPos = (int)log2(positionBlackKing & -positionBlackKing);
+        kingPos = __builtin_ctzll(positionBlackKing);
     } else {  // Black is attacking White's King
         kingPiece = Piece::WHITEKING;
-        kingPos = (int)log2(positionWhiteKing & -positionWhiteKing);
+        kingPos = __builtin_ctzll(positionWhiteKing);
     }
 
     kingRow = kingPos >> 3;
@@ -854,3 +848,546 @@ bool Board::isWinInTwoMoves()
     
     return minimax(3, true) == 1;
 }
+
+
+uint64_t Board::__whitePieces() const noexcept
+{
+    return positionWhitePawn | positionWhiteRook | positionWhiteBishop |
+           positionWhiteKnight | positionWhiteQueen | positionWhiteKing;
+}
+
+uint64_t Board::__blackPieces() const noexcept
+{
+    return positionBlackPawn | positionBlackRook | positionBlackBishop |
+           positionBlackKnight | positionBlackQueen | positionBlackKing;
+}
+
+bool Board::__isSquareAttacked(int square, bool byWhite, uint64_t occupancy, uint64_t removed) const noexcept
+{
+    // removed holds squares whose pieces are gone in the position being tested
+    uint64_t keep = ~removed;
+
+    if (byWhite)
+        return (Attacks::pawn(square, false) & positionWhitePawn & keep) ||
+               (Attacks::knight(square) & positionWhiteKnight & keep) ||
+               (Attacks::king(square) & positionWhiteKing & keep) ||
+               (Attacks::rook(square, occupancy) & (positionWhiteRook | positionWhiteQueen) & keep) ||
+               (Attacks::bishop(square, occupancy) & (positionWhiteBishop | positionWhiteQueen) & keep);
+
+    return (Attacks::pawn(square, true) & positionBlackPawn & keep) ||
+           (Attacks::knight(square) & positionBlackKnight & keep) ||
+           (Attacks::king(square) & positionBlackKing & keep) ||
+           (Attacks::rook(square, occupancy) & (positionBlackRook | positionBlackQueen) & keep) ||
+           (Attacks::bishop(square, occupancy) & (positionBlackBishop | positionBlackQueen) & keep);
+}
+
+bool Board::isSquareAttacked(int square, bool byWhite) const noexcept
+{
+    return __isSquareAttacked(square, byWhite, __whitePieces() | __blackPieces(), 0);
+}
+
+bool Board::__isKingSafeAfter(const Move& move) const noexcept
+{
+    bool white = whiteToMove;
+    uint64_t king = white ? positionWhiteKing : positionBlackKing;
+    if (!king)
+        return true;
+
+    uint64_t fromBit = 1ULL << move.from;
+    uint64_t toBit = 1ULL << move.to;
+    uint64_t removed = toBit;
+    uint64_t occupancy = ((__whitePieces() | __blackPieces()) & ~fromBit) | toBit;
+
+    if (move.flags & MOVE_EN_PASSANT)
+    {
+        uint64_t captured = 1ULL << Attacks::square(Attacks::row(move.from), Attacks::col(move.to));
+        removed |= captured;
+        occupancy &= ~captured;
+    }
+
+    int kingSquare = (king & fromBit) ? move.to : __builtin_ctzll(king);
+    return !__isSquareAttacked(kingSquare, !white, occupancy, removed);
+}
+
+bool Board::inCheck() const noexcept
+{
+    return whiteToMove ? isAttackWhite() : isAttackBlack();
+}
+
+bool Board::isLegal(const Move& move) const noexcept
+{
+    MoveList pseudo;
+    __generatePseudoMoves(pseudo);
+
+    for (int i = 0; i < pseudo.count; i++)
+    {
+        const Move& m = pseudo.moves[i];
+        if (m.from == move.from && m.to == move.to && m.promotion == move.promotion)
+            return __isKingSafeAfter(m);
+    }
+
+    return false;
+}
+
+GameStatus Board::status() const noexcept
+{
+    MoveList legal;
+    legalMoves(legal);
+
+    bool check = inCheck();
+    if (legal.count == 0)
+        return check ? GameStatus::CHECKMATE : GameStatus::STALEMATE;
+
+    return check ? GameStatus::CHECK : GameStatus::PLAYING;
+}
+
+void Board::__generatePseudoMoves(MoveList& list, uint8_t kinds) const noexcept
+{
+    bool white = whiteToMove;
+    uint64_t own = white ? __whitePieces() : __blackPieces();
+    uint64_t enemy = white ? __blackPieces() : __whitePieces();
+    uint64_t occupancy = own | enemy;
+
+    int forward = white ? 8 : -8;
+    int startRow = white ? 1 : 6;
+    int lastRow = white ? 7 : 0;
+    int epRow = white ? 4 : 3;
+
+    const Piece whitePromotions[4] = {Piece::WHITEQUEEN, Piece::WHITEROOK, Piece::WHITEBISHOP, Piece::WHITEKNIGHT};
+    const Piece blackPromotions[4] = {Piece::BLACKQUEEN, Piece::BLACKROOK, Piece::BLACKBISHOP, Piece::BLACKKNIGHT};
+    const Piece* promotions = white ? whitePromotions : blackPromotions;
+
+    bool noisy = kinds & MOVES_NOISY;
+    bool quiet = kinds & MOVES_QUIET;
+
+    // Promotions are noisy whether or not they capture
+    auto addPawnMove = [&](int from, int to, uint8_t flags) {
+        if (Attacks::row(to) == lastRow)
+        {
+            for (int i = 0; noisy && i < 4; i++)
+                list.push(from, to, flags, promotions[i]);
+        }
+        else if (quiet || (flags & MOVE_CAPTURE))
+            list.push(from, to, flags);
+    };
+
+    uint64_t pawns = white ? positionWhitePawn : positionBlackPawn;
+    while (pawns)
+    {
+        int from = __builtin_ctzll(pawns);
+        pawns &= pawns - 1;
+
+        int to = from + forward;
+        if (!(occupancy & (1ULL << to)))
+        {
+            addPawnMove(from, to, MOVE_QUIET);
+            if (quiet && Attacks::row(from) == startRow && !(occupancy & (1ULL << (to + forward))))
+                list.push(from, to + forward, MOVE_DOUBLE_PUSH);
+        }
+
+        uint64_t captures = noisy ? Attacks::pawn(from, white) & enemy : 0;
+        while (captures)
+        {
+            addPawnMove(from, __builtin_ctzll(captures), MOVE_CAPTURE);
+            captures &= captures - 1;
+        }
+
+        if (noisy && enPassantCol >= 0 && Attacks::row(from) == epRow)
+        {
+            int epSquare = Attacks::square(epRow + (white ? 1 : -1), enPassantCol);
+            if (Attacks::pawn(from, white) & (1ULL << epSquare))
+                list.push(from, epSquare, MOVE_CAPTURE | MOVE_EN_PASSANT);
+        }
+    }
+
+    uint64_t wanted = (noisy ? enemy : 0) | (quiet ? ~occupancy : 0);
+    auto addTargets = [&](int from, uint64_t targets) {
+        targets &= wanted;
+        while (targets)
+        {
+            int to = __builtin_ctzll(targets);
+            list.push(from, to, (enemy & (1ULL << to)) ? MOVE_CAPTURE : MOVE_QUIET);
+            targets &= targets - 1;
+        }
+    };
+
+    for (uint64_t knights = white ? positionWhiteKnight : positionBlackKnight; knights; knights &= knights - 1)
+        addTargets(__builtin_ctzll(knights), Attacks::knight(__builtin_ctzll(knights)));
+
+    for (uint64_t bishops = white ? positionWhiteBishop : positionBlackBishop; bishops; bishops &= bishops - 1)
+        addTargets(__builtin_ctzll(bishops), Attacks::bishop(__builtin_ctzll(bishops), occupancy));
+
+    for (uint64_t rooks = white ? positionWhiteRook : positionBlackRook; rooks; rooks &= rooks - 1)
+        addTargets(__builtin_ctzll(rooks), Attacks::rook(__builtin_ctzll(rooks), occupancy));
+
+    for (uint64_t queens = white ? positionWhiteQueen : positionBlackQueen; queens; queens &= queens - 1)
+        addTargets(__builtin_ctzll(queens), Attacks::queen(__builtin_ctzll(queens), occupancy));
+
+    uint64_t king = white ? positionWhiteKing : positionBlackKing;
+    if (!king)
+        return;
+
+    int kingSquare = __builtin_ctzll(king);
+    addTargets(kingSquare, Attacks::king(kingSquare));
+    if (!quiet)
+        return;
+
+    // Castling: the rights guarantee king and rook are at home, the squares in
+    // between must be empty and the king may not pass through an attack
+    int row = white ? 0 : 7;
+    uint8_t shortRight = white ? WHITE_OO : BLACK_OO;
+    uint8_t longRight = white ? WHITE_OOO : BLACK_OOO;
+
+    auto empty = [&](int col) { return !(occupancy & (1ULL << Attacks::square(row, col))); };
+    auto safe = [&](int col) { return !isSquareAttacked(Attacks::square(row, col), !white); };
+
+    if ((castlingRights & shortRight) && empty(5) && empty(6) && safe(4) && safe(5) && safe(6))
+        list.push(kingSquare, Attacks::square(row, 6), MOVE_CASTLE);
+
+    if ((castlingRights & longRight) && empty(1) && empty(2) && empty(3) && safe(4) && safe(3) && safe(2))
+        list.push(kingSquare, Attacks::square(row, 2), MOVE_CASTLE);
+}
+
+void Board::legalMoves(MoveList& list) const noexcept
+{
+    MoveList pseudo;
+    __generatePseudoMoves(pseudo);
+
+    for (int i = 0; i < pseudo.count; i++)
+        if (__isKingSafeAfter(pseudo.moves[i]))
+            list.moves[list.count++] = pseudo.moves[i];
+}
+
+bool Board::hasLegalMove() const noexcept
+{
+    // The king usually has a safe step, which settles it without generating moves
+    uint64_t king = whiteToMove ? positionWhiteKing : positionBlackKing;
+    uint64_t own = whiteToMove ? __whitePieces() : __blackPieces();
+    if (king)
+    {
+        int from = __builtin_ctzll(king);
+        for (uint64_t steps = Attacks::king(from) & ~own; steps; steps &= steps - 1)
+            if (__isKingSafeAfter({static_cast<uint8_t>(from), static_cast<uint8_t>(__builtin_ctzll(steps)), Piece::NONE, MOVE_QUIET}))
+                return true;
+    }
+
+    MoveList pseudo;
+    __generatePseudoMoves(pseudo);
+
+    for (int i = 0; i < pseudo.count; i++)
+        if (__isKingSafeAfter(pseudo.moves[i]))
+            return true;
+    return false;
+}
+
+void Board::makeMove(const Move& move) noexcept
+{
+    uint64_t fromBit = 1ULL << move.from;
+    uint64_t toBit = 1ULL << move.to;
+    int rowFrom = Attacks::row(move.from);
+    int colFrom = Attacks::col(move.from);
+    int rowTo = Attacks::row(move.to);
+    int colTo = Attacks::col(move.to);
+
+    Piece piece = get(rowFrom, colFrom);
+    Piece captured = get(rowTo, colTo);
+    bool white = (int)piece <= (int)Piece::WHITEKING;
+
+    if (captured != Piece::NONE)
+        getEncoding(captured) &= ~toBit;
+
+    if (move.flags & MOVE_EN_PASSANT)
+        getEncoding(white ? Piece::BLACKPAWN : Piece::WHITEPAWN) &= ~(1ULL << Attacks::square(rowFrom, colTo));
+
+    getEncoding(piece) &= ~fromBit;
+    getEncoding(move.promotion != Piece::NONE ? move.promotion : piece) |= toBit;
+
+    if (move.flags & MOVE_CASTLE)
+    {
+        Piece rook = white ? Piece::WHITEROOK : Piece::BLACKROOK;
+        bool kingSide = colTo == 6;
+        getEncoding(rook) &= ~(1ULL << Attacks::square(rowTo, kingSide ? 7 : 0));
+        getEncoding(rook) |= 1ULL << Attacks::square(rowTo, kingSide ? 5 : 3);
+    }
+
+    enPassantCol = (move.flags & MOVE_DOUBLE_PUSH) ? colFrom : -1;
+
+    // Moving from or onto a king or rook home square loses the matching rights
+    auto rightsKept = [](int square) -> uint8_t {
+        switch (square)
+        {
+            case 3:  return static_cast<uint8_t>(~(WHITE_OO | WHITE_OOO)); // e1
+            case 0:  return static_cast<uint8_t>(~WHITE_OO);               // h1
+            case 7:  return static_cast<uint8_t>(~WHITE_OOO);              // a1
+            case 59: return static_cast<uint8_t>(~(BLACK_OO | BLACK_OOO)); // e8
+            case 56: return static_cast<uint8_t>(~BLACK_OO);               // h8
+            case 63: return static_cast<uint8_t>(~BLACK_OOO);              // a8
+            default: return 0xff;
+        }
+    };
+    castlingRights &= rightsKept(move.from) & rightsKept(move.to);
+
+    whiteToMove = !white;
+}
+
+void Board::makeMove(const Move& move, UndoInfo& undo) noexcept
+{
+    undo.captured = (move.flags & MOVE_EN_PASSANT) ? Piece::NONE : get(Attacks::row(move.to), Attacks::col(move.to));
+    undo.castlingRights = castlingRights;
+    undo.enPassantCol = enPassantCol;
+
+    makeMove(move);
+}
+
+void Board::makeMove(const Move& move, UndoInfo& undo, uint64_t& key) noexcept
+{
+    undo.key = key;
+    key ^= Zobrist::enPassantTerm(*this);
+
+    makeMove(move, undo);
+
+    // The moved piece is found on its target square, unless it promoted there
+    Piece placed = get(Attacks::row(move.to), Attacks::col(move.to));
+    Piece moved = move.promotion == Piece::NONE ? placed : (whiteToMove ? Piece::BLACKPAWN : Piece::WHITEPAWN);
+    key ^= Zobrist::moveKey(move, moved, undo.captured, undo.castlingRights ^ castlingRights) ^
+           Zobrist::enPassantTerm(*this);
+}
+
+void Board::unmakeMove(const Move& move, const UndoInfo& undo, uint64_t& key) noexcept
+{
+    unmakeMove(move, undo);
+    key = undo.key;
+}
+
+void Board::unmakeMove(const Move& move, const UndoInfo& undo) noexcept
+{
+    uint64_t fromBit = 1ULL << move.from;
+    uint64_t toBit = 1ULL << move.to;
+    int rowFrom = Attacks::row(move.from);
+    int rowTo = Attacks::row(move.to);
+    int colTo = Attacks::col(move.to);
+
+    bool white = !whiteToMove;
+    Piece moved = get(rowTo, colTo);
+    Piece piece = move.promotion != Piece::NONE ? (white ? Piece::WHITEPAWN : Piece::BLACKPAWN) : moved;
+
+    getEncoding(moved) &= ~toBit;
+    getEncoding(piece) |= fromBit;
+
+    if (undo.captured != Piece::NONE)
+        getEncoding(undo.captured) |= toBit;
+
+    if (move.flags & MOVE_EN_PASSANT)
+        getEncoding(white ? Piece::BLACKPAWN : Piece::WHITEPAWN) |= 1ULL << Attacks::square(rowFrom, colTo);
+
+    if (move.flags & MOVE_CASTLE)
+    {
+        Piece rook = white ? Piece::WHITEROOK : Piece::BLACKROOK;
+        bool kingSide = colTo == 6;
+        getEncoding(rook) &= ~(1ULL << Attacks::square(rowTo, kingSide ? 5 : 3));
+        getEncoding(rook) |= 1ULL << Attacks::square(rowTo, kingSide ? 7 : 0);
+    }
+
+    castlingRights = undo.castlingRights;
+    enPassantCol = undo.enPassantCol;
+    whiteToMove = white;
+}
+
+std::string Move::toString() const
+{
+    std::string text;
+    text += static_cast<char>('a' + Attacks::col(from));
+    text += static_cast<char>('1' + Attacks::row(from));
+    text += static_cast<char>('a' + Attacks::col(to));
+    text += static_cast<char>('1' + Attacks::row(to));
+
+    if (promotion != Piece::NONE)
+        text += "?rbnq"[((int)promotion - 1) % 6];
+
+    return text;
+}
+
+bool Board::parseMove(const char* text, Move& move) const
+{
+    if (std::strlen(text) < 4 || text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8' ||
+        text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8')
+        return false;
+
+    int from = Attacks::square(text[1] - '1', text[0] - 'a');
+    int to = Attacks::square(text[3] - '1', text[2] - 'a');
+    char promotion = text[4];
+
+    MoveList legal;
+    legalMoves(legal);
+
+    for (int i = 0; i < legal.count; i++)
+    {
+        const Move& m = legal.moves[i];
+        if (m.from != from || m.to != to)
+            continue;
+
+        char letter = m.promotion == Piece::NONE ? '\0' : "?rbnq"[((int)m.promotion - 1) % 6];
+        if (letter == promotion)
+        {
+            move = m;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Move Board::unpackMove(uint16_t packed) const noexcept
+{
+    Move move;
+    move.from = packed & 63;
+    move.to = (packed >> 6) & 63;
+    move.flags = MOVE_QUIET;
+
+    int rowFrom = Attacks::row(move.from), colFrom = Attacks::col(move.from);
+    int rowTo = Attacks::row(move.to), colTo = Attacks::col(move.to);
+    Piece piece = get(rowFrom, colFrom);
+    bool white = (int)piece <= (int)Piece::WHITEKING;
+
+    int type = packed >> 12;
+    move.promotion = type ? static_cast<Piece>(type + 1 + (white ? 0 : 6)) : Piece::NONE;
+
+    if (get(rowTo, colTo) != Piece::NONE)
+        move.flags |= MOVE_CAPTURE;
+
+    if (piece == Piece::WHITEPAWN || piece == Piece::BLACKPAWN)
+    {
+        if (colFrom != colTo && !(move.flags & MOVE_CAPTURE))
+            move.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+        if (std::abs(rowTo - rowFrom) == 2)
+            move.flags |= MOVE_DOUBLE_PUSH;
+    }
+    else if ((piece == Piece::WHITEKING || piece == Piece::BLACKKING) && std::abs(colTo - colFrom) == 2)
+    {
+        move.flags |= MOVE_CASTLE;
+    }
+
+    return move;
+}
+
+bool Board::setFen(const std::string& fen)
+{
+    std::istringstream in(fen);
+    std::string placement, side, castling, enPassant;
+    if (!(in >> placement >> side >> castling >> enPassant))
+        return false;
+
+    const std::string letters = "PRBNQKprbnqk";
+    Board board;
+    for (int p = (int)Piece::WHITEPAWN; p <= (int)Piece::BLACKKING; p++)
+        board.getEncoding(static_cast<Piece>(p)) = 0;
+
+    int row = 7, col = 0;
+    for (char c : placement)
+    {
+        if (c == '/')
+        {
+            if (col != 8 || --row < 0)
+                return false;
+            col = 0;
+        }
+        else if (c >= '1' && c <= '8')
+        {
+            col += c - '0';
+        }
+        else
+        {
+            size_t index = letters.find(c);
+            if (index == std::string::npos || col > 7)
+                return false;
+            board.getEncoding(static_cast<Piece>(index + 1)) |= 1ULL << Attacks::square(row, col++);
+        }
+
+        if (col > 8)
+            return false;
+    }
+
+    if (row != 0 || col != 8 || (side != "w" && side != "b"))
+        return false;
+
+    board.whiteToMove = side == "w";
+    board.castlingRights = 0;
+    for (char c : castling)
+    {
+        if (c == 'K')
+            board.castlingRights |= WHITE_OO;
+        else if (c == 'Q')
+            board.castlingRights |= WHITE_OOO;
+        else if (c == 'k')
+            board.castlingRights |= BLACK_OO;
+        else if (c == 'q')
+            board.castlingRights |= BLACK_OOO;
+    }
+    board.__updateCastlingRights();
+
+    board.enPassantCol = -1;
+    if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h')
+        board.enPassantCol = static_cast<int8_t>(enPassant[0] - 'a');
+
+    // The move generator relies on the invariants, a position from outside
+    // that breaks them never reaches it
+    if (Invariants::check(board))
+        return false;
+
+    *this = board;
+    return true;
+}
+
+std::string Board::getFen() const
+{
+    const char letters[] = ".PRBNQKprbnqk";
+    std::string fen;
+
+    for (int row = 7; row >= 0; row--)
+    {
+        int empty = 0;
+        for (int col = 0; col < 8; col++)
+        {
+            Piece p = get(row, col);
+            if (p == Piece::NONE)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += static_cast<char>('0' + empty);
+            empty = 0;
+            fen += letters[(int)p];
+        }
+        if (empty)
+            fen += static_cast<char>('0' + empty);
+        if (row)
+            fen += '/';
+    }
+
+    fen += whiteToMove ? " w " : " b ";
+
+    if (castlingRights & WHITE_OO)
+        fen += 'K';
+    if (castlingRights & WHITE_OOO)
+        fen += 'Q';
+    if (castlingRights & BLACK_OO)
+        fen += 'k';
+    if (castlingRights & BLACK_OOO)
+        fen += 'q';
+    if (!castlingRights)
+        fen += '-';
+
+    fen += ' ';
+    if (enPassantCol >= 0)
+    {
+        fen += static_cast<char>('a' + enPassantCol);
+        fen += whiteToMove ? '6' : '3';
+    }
+    else
+    {
+        fen += '-';
+    }
+
+    return fen;
+}
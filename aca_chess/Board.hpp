@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <cstdint>
+#include <string>
 
 enum class Piece
 {
@@ -30,14 +31,90 @@ enum class Piece
     BLACKKING
 };
 
+enum CastlingRight : uint8_t
+{
+    WHITE_OO = 1,
+    WHITE_OOO = 2,
+    BLACK_OO = 4,
+    BLACK_OOO = 8
+};
+
 struct Coordinate
 {
     char col;
     uint8_t row;
 };
 
+enum MoveFlag : uint8_t
+{
+    MOVE_QUIET = 0,
+    MOVE_CAPTURE = 1,
+    MOVE_EN_PASSANT = 2,
+    MOVE_CASTLE = 4,
+    MOVE_DOUBLE_PUSH = 8
+};
+
+// Which pseudo-legal moves a generator produces: captures and promotions are
+// noisy, everything else is quiet
+enum MoveKind : uint8_t
+{
+    MOVES_NOISY = 1,
+    MOVES_QUIET = 2,
+    MOVES_ALL = MOVES_NOISY | MOVES_QUIET
+};
+
+// Squares are Board bit indices: row * 8 + (7 - col)
+struct Move
+{
+    uint8_t from;
+    uint8_t to;
+    Piece promotion;
+    uint8_t flags;
+    
+    // from | to << 6 | promoted piece type << 12, the flags follow from the board
+    uint16_t pack() const noexcept
+    {
+        int type = promotion == Piece::NONE ? 0 : ((int)promotion - 1) % 6;
+        return static_cast<uint16_t>(from | (to << 6) | (type << 12));
+    }
+    
+    // Coordinate notation, e.g. "e2e4" or "e7e8q"
+    std::string toString() const;
+};
+
+// What makeMove cannot recover from the move itself
+struct UndoInfo
+{
+    Piece captured;
+    uint8_t castlingRights;
+    int8_t enPassantCol;
+    uint64_t key;           // before the move, kept by the overloads that update a key
+};
+
+struct MoveList
+{
+    Move moves[256];
+    int count = 0;
+    
+    void push(int from, int to, uint8_t flags, Piece promotion = Piece::NONE) noexcept
+    {
+        moves[count++] = {static_cast<uint8_t>(from), static_cast<uint8_t>(to), promotion, flags};
+    }
+};
+
+enum class GameStatus
+{
+    PLAYING,
+    CHECK,
+    CHECKMATE,
+    STALEMATE
+};
+
 class Board
 {
+    friend struct PackedPosition;
+    friend struct Position;
+    
     uint64_t positionWhitePawn;
     uint64_t positionWhiteRook;
     uint64_t positionWhiteBishop;
@@ -51,29 +128,79 @@ class Board
     uint64_t positionBlackKnight;
     uint64_t positionBlackQueen;
     uint64_t positionBlackKing;
+    
+    bool whiteToMove = true;
+    uint8_t castlingRights = WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO;
+    int8_t enPassantCol = -1;   // file of a pawn that just made a double step, -1 if none
 private:
-    uint64_t& getEncoding(Piece piece);
+    uint64_t& getEncoding(Piece piece) noexcept;
     
-    bool isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo);
+    bool isMoveValid(int rowFrom, int colFrom, int rowTo, int colTo) const;
     
     int evaluateBoard();
-    bool isAttackWhite();
-    bool isAttackBlack();
+    bool isAttackWhite() const noexcept;
+    bool isAttackBlack() const noexcept;
     int minimax(int depth, bool isMaximizingPlayer);
     
-    void __set(int row, int col, Piece piece);
+    void __set(int row, int col, Piece piece) noexcept;
     bool __move(int rowFrom, int colFrom, int rowTo, int colTo);
+    void __updateCastlingRights();
+    
+    uint64_t __whitePieces() const noexcept;
+    uint64_t __blackPieces() const noexcept;
+    void __generatePseudoMoves(MoveList& list, uint8_t kinds = MOVES_ALL) const noexcept;
+    bool __isSquareAttacked(int square, bool byWhite, uint64_t occupancy, uint64_t removed) const noexcept;
+    bool __isKingSafeAfter(const Move& move) const noexcept;
 public:
     Board();
     
-    Piece get(int row, int col) const;
-    void set(Coordinate coord, Piece piece);
+    bool operator==(const Board& other) const = default;
+    
+    Piece get(int row, int col) const noexcept;
+    uint64_t getBitboard(Piece piece) const noexcept;
+    
+    bool isWhiteToMove() const noexcept { return whiteToMove; }
+    uint8_t getCastlingRights() const noexcept { return castlingRights; }
+    int getEnPassantCol() const noexcept { return enPassantCol; }
+    void setWhiteToMove(bool white) { whiteToMove = white; }
+    
+    // Queries never modify the board, so one position can be shared by many threads
+    bool isSquareAttacked(int square, bool byWhite) const noexcept;
+    bool inCheck() const noexcept;
+    bool isLegal(const Move& move) const noexcept;
+    void legalMoves(MoveList& list) const noexcept;
+    // Stops at the first legal move instead of checking them all
+    bool hasLegalMove() const noexcept;
+    GameStatus status() const noexcept;
+    
+    // Pseudo-legal moves of the given kinds; leavesKingSafe finishes the
+    // legality check for one of them
+    void pseudoMoves(MoveList& list, uint8_t kinds) const noexcept { __generatePseudoMoves(list, kinds); }
+    bool leavesKingSafe(const Move& move) const noexcept { return __isKingSafeAfter(move); }
+    
+    void makeMove(const Move& move) noexcept;
+    void makeMove(const Move& move, UndoInfo& undo) noexcept;
+    void unmakeMove(const Move& move, const UndoInfo& undo) noexcept;
+    // Also carry key, the Zobrist key of the board, across the move
+    void makeMove(const Move& move, UndoInfo& undo, uint64_t& key) noexcept;
+    void unmakeMove(const Move& move, const UndoInfo& undo, uint64_t& key) noexcept;
+    Move unpackMove(uint16_t packed) const noexcept;
+    bool parseMove(const char* text, Move& move) const;
+    
+    // Reads the first four FEN fields, so EPD lines are accepted as well.
+    // Fails, leaving the board untouched, for malformed text and for
+    // positions Invariants::check rejects
+    bool setFen(const std::string& fen);
+    std::string getFen() const;
+
+    // Returns false for a coordinate off the board
+    bool set(Coordinate coord, Piece piece);
 //    void set(int row, char col, Piece piece);
     bool move(Coordinate fromCoord, Coordinate toCoord);
 //    bool move(int rowFrom, int colFrom, int rowTo, int colTo);
     
     int isMate();
-    int isAttack();
+    int isAttack() const;
     bool isWinInOneMove();
     bool isWinInTwoMoves();
     
@@ -0,0 +1,131 @@
+//
+//  Cpu.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Cpu.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef ACA_X86_DISPATCH
+#include <cpuid.h>
+#endif
+
+namespace
+{
+    Cpu::Level detect()
+    {
+#ifdef ACA_X86_DISPATCH
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("popcnt"))
+            return Cpu::Level::SCALAR;
+        if (!__builtin_cpu_supports("bmi2"))
+            return Cpu::Level::POPCNT;
+        if (!__builtin_cpu_supports("avx2"))
+            return Cpu::Level::BMI2;
+        return Cpu::Level::AVX2;
+#else
+        return Cpu::Level::SCALAR;
+#endif
+    }
+
+    bool slowPext()
+    {
+#ifdef ACA_X86_DISPATCH
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+            return false;
+
+        char vendor[12];
+        std::memcpy(vendor, &ebx, 4);
+        std::memcpy(vendor + 4, &edx, 4);
+        std::memcpy(vendor + 8, &ecx, 4);
+        bool amd = std::memcmp(vendor, "AuthenticAMD", 12) == 0;
+        bool hygon = std::memcmp(vendor, "HygonGenuine", 12) == 0;
+        if ((!amd && !hygon) || !__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            return false;
+
+        unsigned family = (eax >> 8) & 0xf;
+        if (family == 0xf)
+            family += (eax >> 20) & 0xff;
+        return amd ? family == 0x17 : family == 0x18;
+#else
+        return false;
+#endif
+    }
+
+    Cpu::Level startupLevel()
+    {
+        Cpu::Level level = Cpu::detected();
+
+        const char* forced = std::getenv("ACA_CPU");
+        if (!forced)
+            return level;
+
+        Cpu::Level requested;
+        if (!Cpu::parse(forced, requested))
+            std::cerr << "Unknown ACA_CPU=" << forced << ", using " << Cpu::name(level) << std::endl;
+        else if (requested > level)
+            std::cerr << "This CPU does not support " << forced << ", using " << Cpu::name(level) << std::endl;
+        else
+            level = requested;
+
+        return level;
+    }
+
+    bool startupPext()
+    {
+        Cpu::Level requested;
+        const char* forced = std::getenv("ACA_CPU");
+        if (forced && Cpu::parse(forced, requested) && requested >= Cpu::Level::BMI2)
+            return true;
+        return !slowPext();
+    }
+}
+
+Cpu::Level Cpu::activeLevel = startupLevel();
+bool Cpu::pextPreferred = startupPext();
+
+Cpu::Level Cpu::detected()
+{
+    static const Level level = detect();
+    return level;
+}
+
+bool Cpu::setActive(Level level)
+{
+    if (level > detected())
+        return false;
+
+    activeLevel = level;
+    return true;
+}
+
+const char* Cpu::name(Level level)
+{
+    switch (level)
+    {
+        case Level::SCALAR: return "scalar";
+        case Level::POPCNT: return "popcnt";
+        case Level::BMI2:   return "bmi2";
+        case Level::AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+bool Cpu::parse(const char* text, Level& level)
+{
+    for (Level candidate : {Level::SCALAR, Level::POPCNT, Level::BMI2, Level::AVX2})
+    {
+        if (std::strcmp(text, name(candidate)) == 0)
+        {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
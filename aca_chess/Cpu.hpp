@@ -0,0 +1,51 @@
+//
+//  Cpu.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Cpu_hpp
+#define Cpu_hpp
+
+#include <cstdint>
+
+// x86-64 builds carry kernels for several instruction sets, compiled with
+// function target attributes, and pick one at runtime. Other targets only
+// have the portable code.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ACA_X86_DISPATCH 1
+#endif
+
+// The instruction set level the bit manipulation kernels use. CPUID is read
+// once at startup; the ACA_CPU environment variable (scalar, popcnt, bmi2 or
+// avx2) forces a lower level so every variant can be run on one machine.
+//
+// AMD Zen 1 and 2 (family 0x17, and Hygon's 0x18) implement PEXT in microcode,
+// so slider lookups index their tables with magic multiplication there instead,
+// unless ACA_CPU asks for bmi2 or avx2 explicitly.
+namespace Cpu
+{
+    enum class Level : uint8_t
+    {
+        SCALAR,
+        POPCNT,     // hardware popcount
+        BMI2,       // + PEXT slider lookups
+        AVX2        // + vectorised evaluation
+    };
+
+    extern Level activeLevel;
+    extern bool pextPreferred;
+
+    Level detected();
+    inline Level active() { return activeLevel; }
+    inline bool usesPext() { return activeLevel >= Level::BMI2 && pextPreferred; }
+
+    // Fails if this machine does not support the level
+    bool setActive(Level level);
+
+    const char* name(Level level);
+    bool parse(const char* text, Level& level);
+}
+
+#endif /* Cpu_hpp */
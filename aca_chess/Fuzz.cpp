@@ -0,0 +1,287 @@
+//
+//  Fuzz.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Fuzz.hpp"
+#include "Invariants.hpp"
+#include "MovePicker.hpp"
+#include "PackedPosition.hpp"
+#include "Search.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class Fuzzer
+    {
+        const FuzzOptions& options;
+        FuzzReport& report;
+        std::mt19937_64 random;
+        Search search;
+        std::vector<Board> samples;     // positions the games went through
+
+        void fail(const Board& board, const char* what)
+        {
+            // Later failures are usually the same bug again
+            if (report.failures++ < 10)
+                std::cerr << "fuzz: " << what << " in " << board.getFen() << std::endl;
+        }
+
+        // Compares the moves as sets, packed together with their flags
+        static bool sameMoves(const MoveList& a, const MoveList& b)
+        {
+            if (a.count != b.count)
+                return false;
+
+            uint32_t packedA[256], packedB[256];
+            for (int i = 0; i < a.count; i++)
+            {
+                packedA[i] = a.moves[i].pack() | static_cast<uint32_t>(a.moves[i].flags) << 16;
+                packedB[i] = b.moves[i].pack() | static_cast<uint32_t>(b.moves[i].flags) << 16;
+            }
+            std::sort(packedA, packedA + a.count);
+            std::sort(packedB, packedB + b.count);
+            return std::equal(packedA, packedA + a.count, packedB);
+        }
+
+        void checkPosition(const Board& board, const Position& position, const MoveList& legal)
+        {
+            if (const char* failure = Invariants::check(board))
+                fail(board, failure);
+            if (const char* failure = Invariants::check(position))
+                fail(board, failure);
+
+            Position converted;
+            Position::fromBoard(board, converted);
+            if (std::memcmp(&converted, &position, sizeof(Position)) != 0)
+                fail(board, "Board and Position diverged");
+
+            MoveList positionLegal;
+            position.legalMoves(positionLegal);
+            if (!sameMoves(legal, positionLegal))
+                fail(board, "Board and Position generate different moves");
+            if (board.hasLegalMove() != (legal.count > 0) || position.hasLegalMove() != (legal.count > 0))
+                fail(board, "hasLegalMove disagrees with move generation");
+        }
+
+        // Random packed moves go through the same validation as hash moves and
+        // killers. Most start on a piece of the side to move, so they get past
+        // the first test and exercise the per-piece rules
+        void checkProbes(const Board& board, const Position& position)
+        {
+            uint64_t own = 0;
+            for (int p = 0; p < 6; p++)
+                own |= board.getBitboard(static_cast<Piece>(p + (board.isWhiteToMove() ? 1 : 7)));
+
+            for (int i = 0; i < options.probes; i++)
+            {
+                uint16_t packed = static_cast<uint16_t>(random() & 0x7fff);
+                if (own && random() % 4)
+                {
+                    uint64_t pieces = own;
+                    for (int skip = static_cast<int>(random() % __builtin_popcountll(own)); skip > 0; skip--)
+                        pieces &= pieces - 1;
+
+                    // Mostly without the promotion bits, which only pawns on the 7th row may use
+                    packed = static_cast<uint16_t>((packed & ~63) | __builtin_ctzll(pieces));
+                    if (random() % 4)
+                        packed &= 0x0fff;
+                }
+
+                Move move = board.unpackMove(packed);
+                bool legal = board.isLegal(move);
+
+                bool fromBoard = MovePicker<Board>::isPseudoLegal(board, move) && board.leavesKingSafe(move);
+                Position next;
+                Move positionMove = position.unpackMove(packed);
+                bool fromPosition = MovePicker<Position>::isPseudoLegal(position, positionMove) &&
+                                    position.makeMove(positionMove, next);
+
+                if (fromBoard != legal || fromPosition != legal)
+                    fail(board, "lazy legality disagrees with move generation");
+                report.probes++;
+            }
+        }
+
+        void checkSearch(const Board& board)
+        {
+            SearchLimits limits;
+            limits.depth = 3;
+            limits.nodes = 20000;
+
+            SearchResult makeUnmake = search.run(board, limits, SearchBackend::MAKE_UNMAKE);
+            SearchResult copyMake = search.run(board, limits, SearchBackend::COPY_MAKE);
+            report.searches++;
+
+            if (makeUnmake.nodes != copyMake.nodes || makeUnmake.score != copyMake.score ||
+                makeUnmake.best.pack() != copyMake.best.pack())
+                fail(board, "search backends disagree");
+            if (makeUnmake.hasMove && !board.isLegal(makeUnmake.best))
+                fail(board, "search returned an illegal move");
+        }
+
+        bool checkMove(Board& board, const Position& position, const Move& move, Position& next)
+        {
+            Board before = board;
+            uint64_t key = Zobrist::polyglotKey(board);
+            uint64_t updated = key;
+
+            UndoInfo undo;
+            board.makeMove(move, undo, updated);
+            if (updated != Zobrist::polyglotKey(board))
+                fail(before, "Board::makeMove updates the key wrongly");
+            board.unmakeMove(move, undo, updated);
+            if (!(board == before) || Zobrist::polyglotKey(board) != key || updated != key)
+                fail(before, "unmakeMove does not restore the board");
+
+            board.makeMove(move, undo);
+            updated = key;
+            if (!position.makeMove(move, next, updated))
+            {
+                fail(before, "Position refuses a legal move");
+                return false;
+            }
+            if (updated != Zobrist::polyglotKey(next))
+                fail(before, "Position::makeMove updates the key wrongly");
+            return true;
+        }
+        // A position from outside, only reached when setFen or unpack took it
+        void checkInput(const Board& board)
+        {
+            Position position;
+            Position::fromBoard(board, position);
+            MoveList legal;
+            board.legalMoves(legal);
+            checkPosition(board, position, legal);
+            checkProbes(board, position);
+
+            if (options.searchEvery > 0 && report.accepted % 8 == 0)
+                checkSearch(board);
+            report.accepted++;
+        }
+
+        void mutateFen(std::string& fen)
+        {
+            static const char alphabet[] = "PRBNQKprbnqk12345678/ wb-KQkqabcdefgh36";
+            for (int edits = 1 + static_cast<int>(random() % 3); edits > 0; edits--)
+            {
+                size_t at = random() % (fen.size() + 1);
+                char c = alphabet[random() % (sizeof(alphabet) - 1)];
+                switch (random() % 3)
+                {
+                    case 0:
+                        if (at < fen.size())
+                            fen[at] = c;
+                        break;
+                    case 1:
+                        fen.insert(fen.begin() + static_cast<std::ptrdiff_t>(at), c);
+                        break;
+                    default:
+                        if (at < fen.size())
+                            fen.erase(at, 1);
+                        break;
+                }
+            }
+        }
+
+        void mutatePacked(const Board& sample, PackedPosition& packed)
+        {
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(&packed);
+            if (random() % 4 == 0 || !PackedPosition::pack(sample, packed))
+            {
+                for (size_t i = 0; i < sizeof(PackedPosition); i += 8)
+                {
+                    uint64_t word = random();
+                    std::memcpy(bytes + i, &word, 8);
+                }
+                return;
+            }
+
+            for (int flips = 1 + static_cast<int>(random() % 3); flips > 0; flips--)
+            {
+                uint64_t bit = random() % (sizeof(PackedPosition) * 8);
+                bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+            }
+        }
+    public:
+        Fuzzer(const FuzzOptions& options, FuzzReport& report) : options(options), report(report), random(options.seed) {}
+
+        void playGame()
+        {
+            Board board;
+            Position position;
+            Position::fromBoard(board, position);
+
+            for (int ply = 0; ply < options.plies; ply++)
+            {
+                MoveList legal;
+                board.legalMoves(legal);
+                checkPosition(board, position, legal);
+                checkProbes(board, position);
+                if (ply % 16 == 0 && samples.size() < 4096)
+                    samples.push_back(board);
+
+                if (options.searchEvery > 0 && ply % options.searchEvery == options.searchEvery - 1)
+                    checkSearch(board);
+
+                if (legal.count == 0)
+                    break;
+
+                Position next;
+                const Move& move = legal.moves[random() % legal.count];
+                if (!checkMove(board, position, move, next))
+                    break;
+
+                position = next;
+                report.moves++;
+            }
+
+            report.games++;
+        }
+
+        void feedInputs()
+        {
+            if (samples.empty())
+                samples.push_back(Board());
+
+            for (int i = 0; i < options.inputs; i++)
+            {
+                const Board& sample = samples[random() % samples.size()];
+                Board board;
+
+                std::string fen = sample.getFen();
+                mutateFen(fen);
+                if (board.setFen(fen))
+                    checkInput(board);
+
+                PackedPosition packed;
+                mutatePacked(sample, packed);
+                if (packed.unpack(board))
+                    checkInput(board);
+
+                report.inputs += 2;
+            }
+        }
+    };
+}
+
+FuzzReport Fuzz::run(const FuzzOptions& options)
+{
+    FuzzReport report;
+    Fuzzer fuzzer(options, report);
+
+    for (int game = 0; game < options.games; game++)
+        fuzzer.playGame();
+    fuzzer.feedInputs();
+
+    return report;
+}
@@ -0,0 +1,49 @@
+//
+//  Fuzz.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Fuzz_hpp
+#define Fuzz_hpp
+
+#include <cstdint>
+
+struct FuzzOptions
+{
+    int games = 200;
+    int plies = 300;            // random moves per game unless it ends earlier
+    uint64_t seed = 1;
+    int probes = 16;            // random packed moves checked per ply
+    int searchEvery = 25;       // plies between short searches, 0 for none
+    int inputs = 2000;          // mutated FEN strings and packed positions
+};
+
+struct FuzzReport
+{
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t probes = 0;
+    uint64_t searches = 0;
+    uint64_t inputs = 0;
+    uint64_t accepted = 0;      // inputs setFen or unpack took
+    uint64_t failures = 0;
+};
+
+// Plays reproducible random games and checks the fast paths against each
+// other after every move: the invariants of both position forms, Board and
+// Position agreeing on the moves and the resulting position, make/unmake
+// restoring the board, incrementally updated keys matching recomputed ones,
+// the lazy legality check of the move picker against full legal generation,
+// and both search backends returning the same legal move. After the games,
+// FEN strings and packed positions of positions seen on the way are mutated,
+// packed positions are also made of random bytes, and whatever setFen or
+// unpack accepts has to pass the same checks. The first failures are printed
+// with their FEN.
+namespace Fuzz
+{
+    FuzzReport run(const FuzzOptions& options);
+}
+
+#endif /* Fuzz_hpp */
@@ -9,6 +9,8 @@
 #include "Game.hpp"
 #endif
 
+#include "Attacks.hpp"
+
 #include <iostream>
 #include <bitset>
 #include <locale>
@@ -44,11 +46,50 @@ void Game::init()
 //    board.set({'h', 2}, Piece::BLACKPAWN);
 //    board.set({'e', 8}, Piece::BLACKKING);
 //    board.set({'b', 7}, Piece::BLACKBISHOP);
+    
+    history.reset(board);
+}
+
+bool Game::loadBook(const char* path)
+{
+    return book.open(path);
+}
+
+void Game::start(const Board& position)
+{
+    board = position;
+    history.reset(position);
+}
+
+bool Game::play(const Move& move)
+{
+    if (!board.isLegal(move))
+        return false;
+    
+    // The flags are recomputed so the history can always take the move back
+    Move played = board.unpackMove(move.pack());
+    UndoInfo undo;
+    board.makeMove(played, undo);
+    history.record(board, played, undo);
+    return true;
 }
 
 void Game::update()
 {
+    // Positions the book knows are answered without searching
+    BookMove move;
+    if (!book.isOpen() || !book.pick(board, move))
+        return;
+    
+    Move candidate;
+    candidate.from = static_cast<uint8_t>(Attacks::square(move.from.row - 1, move.from.col - 'a'));
+    candidate.to = static_cast<uint8_t>(Attacks::square(move.to.row - 1, move.to.col - 'a'));
+    candidate.promotion = move.promotion;
+    candidate.flags = MOVE_QUIET;
     
+    // A corrupt book or a key collision can suggest anything
+    if (!play(candidate))
+        std::cerr << "Ignoring book move " << candidate.toString() << ", it is not legal here" << std::endl;
 }
 
 void Game::draw()
@@ -9,13 +9,30 @@
 #define Game_hpp
 
 #include "Board.hpp"
+#include "GameHistory.hpp"
+#include "OpeningBook.hpp"
 
 class Game
 {
 private:
     Board board;
+    OpeningBook book;
+    GameHistory history;
     
 public:
+    bool loadBook(const char* path);
+    
+    void start(const Board& position);
+    const Board& getBoard() const { return board; }
+    const GameHistory& getHistory() const { return history; }
+    size_t heapBytes() const { return history.heapBytes(); }
+    bool play(const Move& move);
+    
+    bool takeback() { return history.takeback(board); }
+    bool redo() { return history.redo(board); }
+    bool jumpToPly(int ply) { return history.jumpToPly(board, ply); }
+    void goTo(uint32_t node) { history.goTo(board, node); }
+    
     void init();
     void update();
     void draw();
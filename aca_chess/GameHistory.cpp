@@ -0,0 +1,176 @@
+//
+//  GameHistory.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "GameHistory.hpp"
+
+GameHistory::GameHistory()
+{
+    reset(Board());
+}
+
+void GameHistory::reset(const Board& position)
+{
+    nodes.clear();
+    checkpoints.clear();
+    line.clear();
+
+    Node root{};
+    root.parent = root.firstChild = root.nextSibling = NONE;
+    root.checkpoint = 0;
+    nodes.push_back(root);
+    checkpoints.push_back(position);
+    line.push_back(0);
+
+    current = 0;
+    rootWhiteToMove = position.isWhiteToMove();
+}
+
+Move GameHistory::moveAt(const Node& node) const
+{
+    // Plies alternate sides from the root position
+    bool white = ((node.ply - 1) % 2 == 0) == rootWhiteToMove;
+    int type = node.move >> 12;
+
+    Move move;
+    move.from = node.move & 63;
+    move.to = (node.move >> 6) & 63;
+    move.promotion = type ? static_cast<Piece>(type + 1 + (white ? 0 : 6)) : Piece::NONE;
+    move.flags = node.flags;
+    return move;
+}
+
+uint32_t GameHistory::findChild(uint32_t node, uint16_t move) const
+{
+    for (uint32_t child = nodes[node].firstChild; child != NONE; child = nodes[child].nextSibling)
+        if (nodes[child].move == move)
+            return child;
+    return NONE;
+}
+
+void GameHistory::record(const Board& board, const Move& move, const UndoInfo& undo)
+{
+    uint16_t packed = move.pack();
+    uint32_t child = findChild(current, packed);
+
+    if (child == NONE)
+    {
+        Node node;
+        node.move = packed;
+        node.flags = move.flags;
+        node.castlingRights = undo.castlingRights;
+        node.enPassantCol = undo.enPassantCol;
+        node.captured = static_cast<uint8_t>(undo.captured);
+        node.ply = static_cast<uint16_t>(nodes[current].ply + 1);
+        node.parent = current;
+        node.firstChild = node.nextSibling = NONE;
+        node.checkpoint = NONE;
+
+        if (node.ply % CHECKPOINT_INTERVAL == 0)
+        {
+            node.checkpoint = static_cast<uint32_t>(checkpoints.size());
+            checkpoints.push_back(board);
+        }
+
+        child = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(node);
+
+        // New variations go after the existing ones, the first child stays the main line
+        uint32_t* link = &nodes[current].firstChild;
+        while (*link != NONE)
+            link = &nodes[*link].nextSibling;
+        *link = child;
+    }
+
+    // Playing the next move of the line keeps the rest of it
+    if (!onLine(child))
+    {
+        line.resize(nodes[child].ply);
+        line.push_back(child);
+    }
+    current = child;
+}
+
+bool GameHistory::takeback(Board& board)
+{
+    const Node& node = nodes[current];
+    if (node.parent == NONE)
+        return false;
+
+    UndoInfo undo;
+    undo.captured = static_cast<Piece>(node.captured);
+    undo.castlingRights = node.castlingRights;
+    undo.enPassantCol = node.enPassantCol;
+    board.unmakeMove(moveAt(node), undo);
+
+    current = node.parent;
+    return true;
+}
+
+bool GameHistory::redo(Board& board)
+{
+    size_t next = nodes[current].ply + 1;
+    if (next >= line.size())
+        return false;
+
+    board.makeMove(moveAt(nodes[line[next]]));
+    current = line[next];
+    return true;
+}
+
+void GameHistory::goTo(Board& board, uint32_t target)
+{
+    if (target == current || target >= nodes.size())
+        return;
+
+    // A node off the current line starts a new one that ends at it
+    if (!onLine(target))
+    {
+        uint32_t branch = target;
+        while (!onLine(branch))
+            branch = nodes[branch].parent;
+
+        line.resize(nodes[target].ply + 1);
+        for (uint32_t node = target; node != branch; node = nodes[node].parent)
+            line[nodes[node].ply] = node;
+    }
+
+    // Neighbours are one make or unmake away
+    if (nodes[target].parent == current)
+    {
+        redo(board);
+        return;
+    }
+    if (nodes[current].parent == target)
+    {
+        takeback(board);
+        return;
+    }
+
+    uint32_t path[CHECKPOINT_INTERVAL];
+    int length = 0;
+    uint32_t node = target;
+    while (nodes[node].checkpoint == NONE)
+    {
+        path[length++] = node;
+        node = nodes[node].parent;
+    }
+
+    board = checkpoints[nodes[node].checkpoint];
+    while (length > 0)
+        board.makeMove(moveAt(nodes[path[--length]]));
+
+    current = target;
+}
+
+bool GameHistory::jumpToPly(Board& board, int ply)
+{
+    if (ply < 0 || ply >= static_cast<int>(line.size()))
+        return false;
+
+    goTo(board, line[ply]);
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+//  GameHistory.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef GameHistory_hpp
+#define GameHistory_hpp
+
+#include "Board.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// The moves of a game and all its variations as a tree of compact nodes in
+// one contiguous buffer. A node keeps the 16-bit move that led to it and the
+// undo record to take it back, so stepping one ply either way is a single
+// make or unmake. Every CHECKPOINT_INTERVAL plies a node also keeps a full
+// Board, and jumping anywhere replays at most that many moves from the
+// nearest checkpoint above the target.
+//
+// The current line runs from the root through the current node to the end
+// of the variation last played or visited; takeback, redo and jumpToPly
+// move along it.
+class GameHistory
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr int CHECKPOINT_INTERVAL = 16;
+
+private:
+    struct Node
+    {
+        uint16_t move;          // Move::pack()
+        uint8_t flags;          // MoveFlag bits of the move
+        uint8_t castlingRights; // before the move
+        int8_t enPassantCol;    // before the move
+        uint8_t captured;       // Piece taken, not counting en passant
+        uint16_t ply;
+        uint32_t parent;
+        uint32_t firstChild;
+        uint32_t nextSibling;
+        uint32_t checkpoint;    // index into checkpoints or NONE
+    };
+    static_assert(sizeof(Node) == 24, "GameHistory::Node must stay 24 bytes");
+
+    std::vector<Node> nodes;
+    std::vector<Board> checkpoints;
+    std::vector<uint32_t> line;     // node of every ply of the current line
+    uint32_t current = 0;
+    bool rootWhiteToMove = true;
+
+    Move moveAt(const Node& node) const;
+    uint32_t findChild(uint32_t node, uint16_t move) const;
+    bool onLine(uint32_t node) const { return nodes[node].ply < line.size() && line[nodes[node].ply] == node; }
+public:
+    GameHistory();
+
+    // Starts a new tree at position
+    void reset(const Board& position);
+
+    // Records a legal move just made on board as a child of the current
+    // node, reusing the child if this move was played here before
+    void record(const Board& board, const Move& move, const UndoInfo& undo);
+
+    bool takeback(Board& board);
+    bool redo(Board& board);
+
+    // Moves board to any node of the tree
+    void goTo(Board& board, uint32_t node);
+    // Moves board to a ply of the current line
+    bool jumpToPly(Board& board, int ply);
+
+    uint32_t currentNode() const { return current; }
+    int ply() const { return nodes[current].ply; }
+    int lineLength() const { return static_cast<int>(line.size()) - 1; }
+    uint32_t parentOf(uint32_t node) const { return nodes[node].parent; }
+    uint32_t firstChildOf(uint32_t node) const { return nodes[node].firstChild; }
+    uint32_t nextSiblingOf(uint32_t node) const { return nodes[node].nextSibling; }
+
+    // The move that led to node, unpacked for the side that played it
+    Move moveTo(uint32_t node) const { return moveAt(nodes[node]); }
+    size_t size() const { return nodes.size(); }
+    // Bytes the tree, checkpoints and line hold on the heap
+    size_t heapBytes() const
+    {
+        return nodes.capacity() * sizeof(Node) + checkpoints.capacity() * sizeof(Board) +
+               line.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif /* GameHistory_hpp */
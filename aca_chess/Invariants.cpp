@@ -0,0 +1,138 @@
+//
+//  Invariants.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Invariants.hpp"
+#include "Attacks.hpp"
+#include "Zobrist.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // Shared by Board and Position, which answer the same queries
+    template <typename P>
+    const char* checkPieces(const P& position)
+    {
+        uint64_t seen = 0;
+        for (int p = (int)Piece::WHITEPAWN; p <= (int)Piece::BLACKKING; p++)
+        {
+            uint64_t bits = position.getBitboard(static_cast<Piece>(p));
+            if (seen & bits)
+                return "two pieces share a square";
+            seen |= bits;
+        }
+
+        uint64_t whiteKing = position.getBitboard(Piece::WHITEKING);
+        uint64_t blackKing = position.getBitboard(Piece::BLACKKING);
+        if (__builtin_popcountll(whiteKing) != 1 || __builtin_popcountll(blackKing) != 1)
+            return "a side does not have exactly one king";
+
+        const uint64_t backRows = 0xff000000000000ffULL;
+        if ((position.getBitboard(Piece::WHITEPAWN) | position.getBitboard(Piece::BLACKPAWN)) & backRows)
+            return "a pawn stands on the first or last row";
+
+        auto at = [&](Piece piece, int row, int col) {
+            return (position.getBitboard(piece) >> Attacks::square(row, col)) & 1;
+        };
+
+        uint8_t rights = position.getCastlingRights();
+        if ((rights & (WHITE_OO | WHITE_OOO)) && !at(Piece::WHITEKING, 0, 4))
+            return "white may castle without its king on e1";
+        if (((rights & WHITE_OO) && !at(Piece::WHITEROOK, 0, 7)) || ((rights & WHITE_OOO) && !at(Piece::WHITEROOK, 0, 0)))
+            return "white may castle without its rook at home";
+        if ((rights & (BLACK_OO | BLACK_OOO)) && !at(Piece::BLACKKING, 7, 4))
+            return "black may castle without its king on e8";
+        if (((rights & BLACK_OO) && !at(Piece::BLACKROOK, 7, 7)) || ((rights & BLACK_OOO) && !at(Piece::BLACKROOK, 7, 0)))
+            return "black may castle without its rook at home";
+
+        // The pawn that just made a double step, with the squares it crossed empty
+        bool white = position.isWhiteToMove();
+        int epCol = position.getEnPassantCol();
+        if (epCol >= 0)
+        {
+            int row = white ? 4 : 3;
+            int step = white ? 1 : -1;
+            if (epCol > 7 || !at(white ? Piece::BLACKPAWN : Piece::WHITEPAWN, row, epCol))
+                return "en-passant file without a pawn that just moved";
+            if ((seen >> Attacks::square(row + step, epCol) & 1) || (seen >> Attacks::square(row + 2 * step, epCol) & 1))
+                return "en-passant file with an occupied path";
+        }
+
+        int kingSquare = __builtin_ctzll(white ? blackKing : whiteKing);
+        if (position.isSquareAttacked(kingSquare, white))
+            return "the side that just moved is in check";
+
+        return nullptr;
+    }
+}
+
+const char* Invariants::check(const Board& board) noexcept
+{
+    if (const char* failure = checkPieces(board))
+        return failure;
+
+    Position position;
+    Board back;
+    Position::fromBoard(board, position);
+    position.toBoard(back);
+    if (!(back == board))
+        return "Board does not survive the conversion to Position";
+    if (Zobrist::polyglotKey(board) != Zobrist::polyglotKey(position))
+        return "Board and Position keys differ";
+
+    return nullptr;
+}
+
+const char* Invariants::checkRules(const Board& board) noexcept
+{
+    return checkPieces(board);
+}
+
+const char* Invariants::check(const Position& position) noexcept
+{
+    if (position.white & ~position.occupancy())
+        return "white squares without a piece";
+    for (int type = 0; type < 6; type++)
+        for (int other = type + 1; other < 6; other++)
+            if (position.pieces[type] & position.pieces[other])
+                return "two piece types share a square";
+
+    if (const char* failure = checkPieces(position))
+        return failure;
+
+    Board board;
+    Position back;
+    position.toBoard(board);
+    Position::fromBoard(board, back);
+    if (std::memcmp(&back, &position, sizeof(Position)) != 0)
+        return "Position does not survive the conversion to Board";
+    if (Zobrist::polyglotKey(board) != Zobrist::polyglotKey(position))
+        return "Board and Position keys differ";
+
+    return nullptr;
+}
+
+const char* Invariants::checkKey(const Board& board, uint64_t key) noexcept
+{
+    return Zobrist::polyglotKey(board) == key ? nullptr : "the incremental key differs from the recomputed one";
+}
+
+const char* Invariants::checkKey(const Position& position, uint64_t key) noexcept
+{
+    return Zobrist::polyglotKey(position) == key ? nullptr : "the incremental key differs from the recomputed one";
+}
+
+void Invariants::expect(const char* failure, const char* file, int line) noexcept
+{
+    if (!failure)
+        return;
+
+    std::fprintf(stderr, "%s:%d: invariant violated: %s\n", file, line, failure);
+    std::abort();
+}
@@ -0,0 +1,53 @@
+//
+//  Invariants.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Invariants_hpp
+#define Invariants_hpp
+
+#include "Board.hpp"
+#include "Position.hpp"
+
+// Consistency checks for positions the engine produced itself, and the gate
+// positions from outside (FEN, packed) pass before the engine works on them:
+// the piece bitboards do not overlap, each side has exactly one king, no pawn
+// stands on the first or last row, the castling rights and en-passant file
+// agree with the pieces, the side that just moved is not in check, and the
+// Board and Position forms convert into each other with the same Zobrist key.
+// checkKey compares an incrementally updated key with the recomputed one.
+//
+// check returns nullptr for a consistent position, otherwise a static
+// description of the first violation. Nothing allocates or throws, so the
+// search can run the checks on every node.
+namespace Invariants
+{
+    const char* check(const Board& board) noexcept;
+
+    // The rules alone, without converting between the two forms: what input
+    // from outside has to satisfy before the engine may work on it. Whatever
+    // passes here and fails check is a bug in the conversions
+    const char* checkRules(const Board& board) noexcept;
+    const char* check(const Position& position) noexcept;
+
+    // For keys carried from move to move instead of recomputed
+    const char* checkKey(const Board& board, uint64_t key) noexcept;
+    const char* checkKey(const Position& position, uint64_t key) noexcept;
+
+    // Reports failure with its location and aborts, does nothing for nullptr
+    void expect(const char* failure, const char* file, int line) noexcept;
+}
+
+// Debug builds, or any build with ACA_CHECK_INVARIANTS, verify every position
+// the search visits
+#if defined(DEBUG) || defined(ACA_CHECK_INVARIANTS)
+#define ACA_DEBUG_CHECK(position) Invariants::expect(Invariants::check(position), __FILE__, __LINE__)
+#define ACA_DEBUG_CHECK_KEY(position, key) Invariants::expect(Invariants::checkKey(position, key), __FILE__, __LINE__)
+#else
+#define ACA_DEBUG_CHECK(position) ((void)0)
+#define ACA_DEBUG_CHECK_KEY(position, key) ((void)0)
+#endif
+
+#endif /* Invariants_hpp */
@@ -0,0 +1,38 @@
+//
+//  MappedFile.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. The pages are loaded lazily by the
+// OS, so opening even a very large file costs no parse time.
+class MappedFile
+{
+    const uint8_t* mapped = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return mapped != nullptr; }
+    const uint8_t* data() const { return mapped; }
+    size_t size() const { return length; }
+};
+
+#endif /* MappedFile_hpp */
@@ -0,0 +1,245 @@
+//
+//  MovePicker.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "MovePicker.hpp"
+#include "Attacks.hpp"
+
+#include <utility>
+
+namespace
+{
+    // Indexed by Piece
+    const int pieceValues[13] = {0, 100, 500, 330, 320, 900, 0, 100, 500, 330, 320, 900, 0};
+
+    Piece pieceOn(const Board& board, int square) { return board.get(Attacks::row(square), Attacks::col(square)); }
+    Piece pieceOn(const Position& position, int square) { return position.pieceAt(square); }
+
+    bool isNoisy(const Move& move)
+    {
+        return (move.flags & MOVE_CAPTURE) || move.promotion != Piece::NONE;
+    }
+
+    template <typename P>
+    int captureScore(const P& position, const Move& move)
+    {
+        int score = 0;
+        if (move.flags & MOVE_CAPTURE)
+        {
+            Piece victim = pieceOn(position, move.to);
+            Piece attacker = pieceOn(position, move.from);
+            int victimValue = victim == Piece::NONE ? 100 : pieceValues[(int)victim];
+            score += 10000 + 10 * victimValue - pieceValues[(int)attacker] / 10;
+        }
+        if (move.promotion != Piece::NONE)
+            score += 9000 + pieceValues[(int)move.promotion];
+        return score;
+    }
+}
+
+template <typename P>
+MovePicker<P>::MovePicker(const P& position, uint16_t hashMove, const Move* killers, bool quiets) noexcept
+    : position(position), hashMove(hashMove), killers(killers), quiets(quiets)
+{
+}
+
+template <typename P>
+bool MovePicker<P>::__isDuplicate(const Move& move) const noexcept
+{
+    uint16_t packed = move.pack();
+    return (hashMove && packed == hashMove) || packed == killersTried[0] || packed == killersTried[1];
+}
+
+template <typename P>
+void MovePicker<P>::__generate(uint8_t kinds) noexcept
+{
+    list.count = 0;
+    index = 0;
+    position.pseudoMoves(list, kinds);
+
+    if (kinds & MOVES_NOISY)
+        for (int i = 0; i < list.count; i++)
+            scores[i] = captureScore(position, list.moves[i]);
+}
+
+template <typename P>
+bool MovePicker<P>::next(Move& move) noexcept
+{
+    switch (stage)
+    {
+        case PickStage::HASH:
+            stage = PickStage::CAPTURES;
+            if (hashMove)
+            {
+                move = position.unpackMove(hashMove);
+                if (isPseudoLegal(position, move))
+                {
+                    // Captures are generated on the next call, if there is one
+                    picked = PickStage::HASH;
+                    generatePending = true;
+                    return true;
+                }
+                hashMove = 0;
+            }
+            __generate(MOVES_NOISY);
+            [[fallthrough]];
+
+        case PickStage::CAPTURES:
+            if (generatePending)
+            {
+                generatePending = false;
+                __generate(MOVES_NOISY);
+            }
+            while (index < list.count)
+            {
+                // Selection sort, one step per pick
+                int best = index;
+                for (int j = index + 1; j < list.count; j++)
+                    if (scores[j] > scores[best])
+                        best = j;
+                std::swap(list.moves[index], list.moves[best]);
+                std::swap(scores[index], scores[best]);
+
+                move = list.moves[index++];
+                if (!__isDuplicate(move))
+                {
+                    picked = PickStage::CAPTURES;
+                    return true;
+                }
+            }
+            if (!quiets)
+                break;
+            stage = PickStage::KILLERS;
+            index = 0;
+            [[fallthrough]];
+
+        case PickStage::KILLERS:
+            while (killers && index < 2)
+            {
+                int slot = index++;
+                if (killers[slot].from == killers[slot].to)
+                    continue;
+
+                // Killers come from sibling nodes, the flags are recomputed here
+                move = position.unpackMove(killers[slot].pack());
+                if (!isNoisy(move) && !__isDuplicate(move) && isPseudoLegal(position, move))
+                {
+                    killersTried[slot] = move.pack();
+                    picked = PickStage::KILLERS;
+                    return true;
+                }
+            }
+            stage = PickStage::QUIETS;
+            __generate(MOVES_QUIET);
+            [[fallthrough]];
+
+        case PickStage::QUIETS:
+            while (index < list.count)
+            {
+                move = list.moves[index++];
+                if (!__isDuplicate(move))
+                {
+                    picked = PickStage::QUIETS;
+                    return true;
+                }
+            }
+            break;
+
+        case PickStage::DONE:
+            break;
+    }
+
+    stage = PickStage::DONE;
+    return false;
+}
+
+template <typename P>
+bool MovePicker<P>::isPseudoLegal(const P& position, const Move& move) noexcept
+{
+    bool white = position.isWhiteToMove();
+    int first = white ? (int)Piece::WHITEPAWN : (int)Piece::BLACKPAWN;
+    int other = white ? (int)Piece::BLACKPAWN : (int)Piece::WHITEPAWN;
+
+    uint64_t own = 0, enemy = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        own |= position.getBitboard(static_cast<Piece>(first + i));
+        enemy |= position.getBitboard(static_cast<Piece>(other + i));
+    }
+
+    uint64_t fromBit = 1ULL << move.from;
+    uint64_t toBit = 1ULL << move.to;
+    if (!(own & fromBit) || (own & toBit))
+        return false;
+
+    uint64_t occupancy = own | enemy;
+    int type = ((int)pieceOn(position, move.from) - 1) % 6;
+    int lastRow = white ? 7 : 0;
+
+    // Only pawns promote, to a rook, bishop, knight or queen of their colour
+    if (move.promotion != Piece::NONE)
+    {
+        int promoted = (int)move.promotion - first;
+        if (type != 0 || promoted < 1 || promoted > 4 || Attacks::row(move.to) != lastRow)
+            return false;
+    }
+
+    switch (type)
+    {
+        case 0:
+        {
+            int forward = white ? 8 : -8;
+            if (Attacks::row(move.to) == lastRow && move.promotion == Piece::NONE)
+                return false;
+
+            if (move.flags & MOVE_EN_PASSANT)
+            {
+                int epRow = white ? 4 : 3;
+                int epCol = position.getEnPassantCol();
+                return epCol >= 0 && Attacks::row(move.from) == epRow &&
+                       move.to == Attacks::square(epRow + (white ? 1 : -1), epCol) &&
+                       (Attacks::pawn(move.from, white) & toBit);
+            }
+            if (enemy & toBit)
+                return Attacks::pawn(move.from, white) & toBit;
+            if (move.to == move.from + forward)
+                return true;
+
+            return move.to == move.from + 2 * forward && Attacks::row(move.from) == (white ? 1 : 6) &&
+                   !(occupancy & (1ULL << (move.from + forward)));
+        }
+        case 1:
+            return Attacks::rook(move.from, occupancy) & toBit;
+        case 2:
+            return Attacks::bishop(move.from, occupancy) & toBit;
+        case 3:
+            return Attacks::knight(move.from) & toBit;
+        case 4:
+            return Attacks::queen(move.from, occupancy) & toBit;
+        default:
+            break;
+    }
+
+    if (!(move.flags & MOVE_CASTLE))
+        return Attacks::king(move.from) & toBit;
+
+    // Same conditions as the generators
+    int row = white ? 0 : 7;
+    bool isShort = move.to == Attacks::square(row, 6);
+    uint8_t right = isShort ? (white ? WHITE_OO : BLACK_OO) : (white ? WHITE_OOO : BLACK_OOO);
+    if (move.from != Attacks::square(row, 4) || !(position.getCastlingRights() & right))
+        return false;
+
+    auto empty = [&](int col) { return !(occupancy & (1ULL << Attacks::square(row, col))); };
+    auto safe = [&](int col) { return !position.isSquareAttacked(Attacks::square(row, col), !white); };
+
+    if (isShort)
+        return empty(5) && empty(6) && safe(4) && safe(5) && safe(6);
+    return move.to == Attacks::square(row, 2) && empty(1) && empty(2) && empty(3) && safe(4) && safe(3) && safe(2);
+}
+
+template class MovePicker<Board>;
+template class MovePicker<Position>;
@@ -0,0 +1,69 @@
+//
+//  MovePicker.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef MovePicker_hpp
+#define MovePicker_hpp
+
+#include "Board.hpp"
+#include "Position.hpp"
+
+#include <cstdint>
+
+enum class PickStage : uint8_t
+{
+    HASH,
+    CAPTURES,
+    KILLERS,
+    QUIETS,
+    DONE
+};
+
+constexpr int PICK_STAGES = 4;
+
+// Hands out the moves of one node in the order they are most likely to cut
+// off: the hash move before anything is generated, then captures and
+// promotions by MVV-LVA, then the killers and finally the remaining quiet
+// moves, which are only generated when the node gets that far.
+//
+// Moves are pseudo-legal. The caller checks legality of the moves it actually
+// tries, so the hash move and killers are validated against the position
+// first and a node that cuts off early never looks at the rest.
+template <typename P>
+class MovePicker
+{
+    const P& position;
+    uint16_t hashMove;
+    const Move* killers;
+    uint16_t killersTried[2] = {0, 0};
+    bool quiets;
+    bool generatePending = false;
+
+    PickStage stage = PickStage::HASH;
+    PickStage picked = PickStage::HASH;
+    MoveList list;
+    int scores[256];
+    int index = 0;
+
+    bool __isDuplicate(const Move& move) const noexcept;
+    void __generate(uint8_t kinds) noexcept;
+public:
+    // hashMove is packed, 0 for none. killers holds two moves or is null;
+    // without quiet moves only the hash move and noisy moves are picked
+    MovePicker(const P& position, uint16_t hashMove, const Move* killers, bool quiets = true) noexcept;
+
+    bool next(Move& move) noexcept;
+    PickStage stageOfLast() const noexcept { return picked; }
+
+    // Whether move, with flags as unpackMove sets them, can be played in
+    // position apart from leaving the king attacked
+    static bool isPseudoLegal(const P& position, const Move& move) noexcept;
+};
+
+extern template class MovePicker<Board>;
+extern template class MovePicker<Position>;
+
+#endif /* MovePicker_hpp */
@@ -0,0 +1,143 @@
+//
+//  OpeningBook.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "OpeningBook.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr size_t ENTRY_SIZE = 16;
+
+    uint64_t readBigEndian(const uint8_t* p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value = (value << 8) | p[i];
+        return value;
+    }
+}
+
+bool OpeningBook::open(const char* path)
+{
+    if (!file.open(path))
+        return false;
+
+    if (file.size() % ENTRY_SIZE != 0)
+    {
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t OpeningBook::keyAt(size_t index) const
+{
+    return readBigEndian(file.data() + index * ENTRY_SIZE, 8);
+}
+
+BookMove OpeningBook::moveAt(size_t index, const Board& board) const
+{
+    const uint8_t* entry = file.data() + index * ENTRY_SIZE;
+    uint16_t raw = static_cast<uint16_t>(readBigEndian(entry + 8, 2));
+
+    int colTo = raw & 7;
+    int rowTo = (raw >> 3) & 7;
+    int colFrom = (raw >> 6) & 7;
+    int rowFrom = (raw >> 9) & 7;
+    int promotion = (raw >> 12) & 7;
+
+    // Polyglot writes castling as the king capturing its own rook
+    Piece p = board.get(rowFrom, colFrom);
+    if ((p == Piece::WHITEKING || p == Piece::BLACKKING) && colFrom == 4)
+    {
+        if (colTo == 7)
+            colTo = 6;
+        else if (colTo == 0)
+            colTo = 2;
+    }
+
+    bool white = (int)p <= (int)Piece::WHITEKING;
+    const Piece promotions[2][5] = {
+        {Piece::NONE, Piece::BLACKKNIGHT, Piece::BLACKBISHOP, Piece::BLACKROOK, Piece::BLACKQUEEN},
+        {Piece::NONE, Piece::WHITEKNIGHT, Piece::WHITEBISHOP, Piece::WHITEROOK, Piece::WHITEQUEEN}
+    };
+
+    BookMove move;
+    move.from = {static_cast<char>('a' + colFrom), static_cast<uint8_t>(rowFrom + 1)};
+    move.to = {static_cast<char>('a' + colTo), static_cast<uint8_t>(rowTo + 1)};
+    move.promotion = promotion <= 4 ? promotions[white][promotion] : Piece::NONE;
+    move.weight = static_cast<uint16_t>(readBigEndian(entry + 10, 2));
+    return move;
+}
+
+size_t OpeningBook::lowerBound(uint64_t key) const
+{
+    size_t lo = 0, hi = entryCount();
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keyAt(mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int OpeningBook::lookup(const Board& board, BookMove* moves, int maxMoves) const
+{
+    if (!isOpen())
+        return 0;
+
+    uint64_t key = Zobrist::polyglotKey(board);
+    size_t count = entryCount();
+
+    int found = 0;
+    for (size_t i = lowerBound(key); i < count && keyAt(i) == key; i++, found++)
+        if (found < maxMoves)
+            moves[found] = moveAt(i, board);
+
+    return found;
+}
+
+bool OpeningBook::pick(const Board& board, BookMove& move)
+{
+    constexpr int MAX_CANDIDATES = 64;
+    BookMove candidates[MAX_CANDIDATES];
+
+    int count = std::min(lookup(board, candidates, MAX_CANDIDATES), MAX_CANDIDATES);
+    if (count == 0)
+        return false;
+
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += candidates[i].weight;
+
+    // Entries with zero weight are only played when nothing else is known
+    if (total == 0)
+    {
+        move = candidates[std::uniform_int_distribution<int>(0, count - 1)(rng)];
+        return true;
+    }
+
+    uint32_t roll = std::uniform_int_distribution<uint32_t>(0, total - 1)(rng);
+    for (int i = 0; i < count; i++)
+    {
+        if (roll < candidates[i].weight)
+        {
+            move = candidates[i];
+            return true;
+        }
+        roll -= candidates[i].weight;
+    }
+
+    move = candidates[count - 1];
+    return true;
+}
@@ -0,0 +1,45 @@
+//
+//  OpeningBook.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef OpeningBook_hpp
+#define OpeningBook_hpp
+
+#include "Board.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <random>
+
+struct BookMove
+{
+    Coordinate from;
+    Coordinate to;
+    Piece promotion;
+    uint16_t weight;
+};
+
+// Polyglot .bin opening book. The file is a sorted array of 16-byte big-endian
+// entries (key, move, weight, learn) and is searched in place through mmap.
+class OpeningBook
+{
+    MappedFile file;
+    std::minstd_rand rng{std::random_device{}()};
+
+    size_t entryCount() const { return file.size() / 16; }
+    uint64_t keyAt(size_t index) const;
+    BookMove moveAt(size_t index, const Board& board) const;
+    size_t lowerBound(uint64_t key) const;
+public:
+    bool open(const char* path);
+    bool isOpen() const { return file.isOpen(); }
+
+    // Writes up to maxMoves candidates and returns how many the book holds
+    int lookup(const Board& board, BookMove* moves, int maxMoves) const;
+    bool pick(const Board& board, BookMove& move);
+};
+
+#endif /* OpeningBook_hpp */
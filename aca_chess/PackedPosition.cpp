@@ -0,0 +1,107 @@
+//
+//  PackedPosition.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "PackedPosition.hpp"
+#include "Invariants.hpp"
+
+#include <cstring>
+
+bool PackedPosition::pack(const Board& board, PackedPosition& packed)
+{
+    // Bit k of a square's Piece code is set in plane k, so codes are read
+    // off the four planes without testing twelve bitboards per square
+    uint64_t occupancy = 0;
+    uint64_t planes[4] = {};
+    for (int code = 1; code <= 12; code++)
+    {
+        uint64_t pieces = board.getBitboard(static_cast<Piece>(code));
+        occupancy |= pieces;
+        for (int k = 0; k < 4; k++)
+            planes[k] |= (code >> k & 1) ? pieces : 0;
+    }
+
+    if (__builtin_popcountll(occupancy) > 32)
+        return false;
+
+    std::memset(&packed, 0, sizeof(packed));
+    packed.occupancy = occupancy;
+
+    int slot = 0;
+    for (uint64_t squares = occupancy; squares; squares &= squares - 1, slot++)
+    {
+        int square = __builtin_ctzll(squares);
+        int code = static_cast<int>((planes[0] >> square & 1) | (planes[1] >> square & 1) << 1 |
+                                    (planes[2] >> square & 1) << 2 | (planes[3] >> square & 1) << 3);
+        packed.pieces[slot >> 1] |= static_cast<uint8_t>(code << ((slot & 1) * 4));
+    }
+
+    packed.state = static_cast<uint8_t>(board.whiteToMove | (board.castlingRights << 1));
+    packed.enPassant = static_cast<uint8_t>(board.enPassantCol + 1);
+    return true;
+}
+
+bool PackedPosition::unpack(Board& board) const
+{
+    // Codes are Piece values; 0 (Piece::NONE) and 13-15 only occur in corrupt
+    // input. The array covers every 4-bit code so they can be rejected after
+    // the loop instead of branching on each square
+    uint64_t bitboards[16] = {};
+
+    if (__builtin_popcountll(occupancy) > 32 || enPassant > 8)
+        return false;
+
+    int slot = 0;
+    for (uint64_t squares = occupancy; squares; squares &= squares - 1, slot++)
+    {
+        int code = (pieces[slot >> 1] >> ((slot & 1) * 4)) & 0xf;
+        bitboards[code] |= squares & -squares;
+    }
+
+    if (bitboards[0] | bitboards[13] | bitboards[14] | bitboards[15])
+        return false;
+
+    Board decoded;
+    decoded.positionWhitePawn = bitboards[(int)Piece::WHITEPAWN];
+    decoded.positionWhiteRook = bitboards[(int)Piece::WHITEROOK];
+    decoded.positionWhiteBishop = bitboards[(int)Piece::WHITEBISHOP];
+    decoded.positionWhiteKnight = bitboards[(int)Piece::WHITEKNIGHT];
+    decoded.positionWhiteQueen = bitboards[(int)Piece::WHITEQUEEN];
+    decoded.positionWhiteKing = bitboards[(int)Piece::WHITEKING];
+    decoded.positionBlackPawn = bitboards[(int)Piece::BLACKPAWN];
+    decoded.positionBlackRook = bitboards[(int)Piece::BLACKROOK];
+    decoded.positionBlackBishop = bitboards[(int)Piece::BLACKBISHOP];
+    decoded.positionBlackKnight = bitboards[(int)Piece::BLACKKNIGHT];
+    decoded.positionBlackQueen = bitboards[(int)Piece::BLACKQUEEN];
+    decoded.positionBlackKing = bitboards[(int)Piece::BLACKKING];
+    decoded.whiteToMove = state & 1;
+    decoded.castlingRights = (state >> 1) & 0xf;
+    decoded.enPassantCol = static_cast<int8_t>(enPassant - 1);
+
+    // Well-formed codes can still describe a position the move generator
+    // cannot handle, such as a missing king or a pawn on the last row
+    if (Invariants::checkRules(decoded))
+        return false;
+
+    board = decoded;
+    return true;
+}
+
+size_t packPositions(const Board* boards, PackedPosition* packed, size_t count)
+{
+    size_t converted = 0;
+    for (size_t i = 0; i < count; i++)
+        converted += PackedPosition::pack(boards[i], packed[i]);
+    return converted;
+}
+
+size_t unpackPositions(const PackedPosition* packed, Board* boards, size_t count)
+{
+    size_t converted = 0;
+    for (size_t i = 0; i < count; i++)
+        converted += packed[i].unpack(boards[i]);
+    return converted;
+}
@@ -0,0 +1,41 @@
+//
+//  PackedPosition.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef PackedPosition_hpp
+#define PackedPosition_hpp
+
+#include "Board.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// 32-byte encoding of a Board for storage and IPC: the occupied squares, one
+// 4-bit Piece code per occupied square in ascending square order, and the
+// side to move, castling rights and en-passant file.
+struct PackedPosition
+{
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t state;          // bit 0 white to move, bits 1-4 castling rights
+    uint8_t enPassant;      // 0 if none, otherwise file + 1
+    uint8_t reserved[6];
+
+    // Fails only for boards with more than 32 pieces
+    static bool pack(const Board& board, PackedPosition& packed);
+    // Fails, leaving board untouched, for more than 32 pieces, a piece code
+    // outside 1-12, an en-passant file past h or a position
+    // Invariants::check rejects
+    bool unpack(Board& board) const;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+// Batch conversions, return the number of positions converted
+size_t packPositions(const Board* boards, PackedPosition* packed, size_t count);
+size_t unpackPositions(const PackedPosition* packed, Board* boards, size_t count);
+
+#endif /* PackedPosition_hpp */
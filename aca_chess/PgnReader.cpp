@@ -0,0 +1,384 @@
+//
+//  PgnReader.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "PgnReader.hpp"
+#include "Attacks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    bool isTokenEnd(char c)
+    {
+        return isSpace(c) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '$';
+    }
+
+    // 0 pawn, 1 rook, 2 bishop, 3 knight, 4 queen, 5 king (the order of Piece)
+    int pieceType(Piece piece)
+    {
+        return ((int)piece - 1) % 6;
+    }
+
+    int pieceTypeFromLetter(char c)
+    {
+        switch (c)
+        {
+            case 'R': return 1;
+            case 'B': return 2;
+            case 'N': return 3;
+            case 'Q': return 4;
+            case 'K': return 5;
+            default:  return -1;
+        }
+    }
+
+    bool tokenIs(const char* begin, const char* end, const char* text)
+    {
+        size_t length = std::strlen(text);
+        return static_cast<size_t>(end - begin) == length && std::memcmp(begin, text, length) == 0;
+    }
+
+    const char* skipPast(const char* p, const char* end, char c)
+    {
+        const void* found = std::memchr(p, c, static_cast<size_t>(end - p));
+        return found ? static_cast<const char*>(found) + 1 : end;
+    }
+
+    // [Name "value"]
+    bool isTagLine(const char* p, const char* end)
+    {
+        if (p == end || *p++ != '[')
+            return false;
+
+        const char* name = p;
+        while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_'))
+            p++;
+        if (p == name)
+            return false;
+
+        while (p < end && *p == ' ')
+            p++;
+        return p < end && *p == '"';
+    }
+}
+
+bool PgnReader::open(const char* path)
+{
+    return file.open(path);
+}
+
+size_t PgnReader::nextGameStart(size_t offset) const
+{
+    const char* text = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+
+    if (offset == 0)
+        return 0;
+
+    // A game starts at a tag line whose previous line is not a tag. The test
+    // only looks at those two lines, so two workers asking for the same
+    // offset agree on the boundary; requiring a [Name " tag keeps wrapped
+    // comments such as { ...\n[%clk 0:01:02] } from splitting a game
+    for (size_t i = offset; i < size; i++)
+    {
+        const void* bracket = std::memchr(text + i, '[', size - i);
+        if (!bracket)
+            break;
+        i = static_cast<size_t>(static_cast<const char*>(bracket) - text);
+
+        if (text[i - 1] != '\n' || !isTagLine(text + i, text + size))
+            continue;
+
+        size_t previous = i - 1;
+        while (previous > 0 && text[previous - 1] != '\n')
+            previous--;
+        if (!isTagLine(text + previous, text + i))
+            return i;
+    }
+
+    return size;
+}
+
+bool PgnReader::matchSan(const Board& board, const MoveList& legal,
+                         const char* begin, const char* end, Move& move)
+{
+    while (end > begin && (end[-1] == '+' || end[-1] == '#' || end[-1] == '!' || end[-1] == '?'))
+        end--;
+
+    if (tokenIs(begin, end, "O-O") || tokenIs(begin, end, "0-0") ||
+        tokenIs(begin, end, "O-O-O") || tokenIs(begin, end, "0-0-0"))
+    {
+        int col = end - begin == 3 ? 6 : 2;
+        for (int i = 0; i < legal.count; i++)
+        {
+            if ((legal.moves[i].flags & MOVE_CASTLE) && Attacks::col(legal.moves[i].to) == col)
+            {
+                move = legal.moves[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int type = 0;
+    if (begin < end && pieceTypeFromLetter(*begin) >= 0)
+        type = pieceTypeFromLetter(*begin++);
+
+    int promotion = -1;
+    if (end - begin >= 3 && pieceTypeFromLetter(end[-1]) > 0)
+    {
+        promotion = pieceTypeFromLetter(*--end);
+        if (end[-1] == '=')
+            end--;
+    }
+
+    if (end - begin < 2 || end[-2] < 'a' || end[-2] > 'h' || end[-1] < '1' || end[-1] > '8')
+        return false;
+
+    int to = Attacks::square(end[-1] - '1', end[-2] - 'a');
+    end -= 2;
+
+    int fromCol = -1, fromRow = -1;
+    for (const char* p = begin; p < end; p++)
+    {
+        if (*p >= 'a' && *p <= 'h')
+            fromCol = *p - 'a';
+        else if (*p >= '1' && *p <= '8')
+            fromRow = *p - '1';
+        else if (*p != 'x' && *p != '-' && *p != ':')
+            return false;
+    }
+
+    int matches = 0;
+    for (int i = 0; i < legal.count; i++)
+    {
+        const Move& m = legal.moves[i];
+        if (m.to != to || (m.flags & MOVE_CASTLE))
+            continue;
+        if (pieceType(board.get(Attacks::row(m.from), Attacks::col(m.from))) != type)
+            continue;
+        if (fromCol >= 0 && Attacks::col(m.from) != fromCol)
+            continue;
+        if (fromRow >= 0 && Attacks::row(m.from) != fromRow)
+            continue;
+        if ((m.promotion == Piece::NONE ? -1 : pieceType(m.promotion)) != promotion)
+            continue;
+
+        move = m;
+        matches++;
+    }
+
+    return matches == 1;
+}
+
+void PgnReader::replayChunk(size_t begin, size_t end, ReplayStats& stats, ReplayVisitor* visitor) const
+{
+    const char* p = reinterpret_cast<const char*>(file.data()) + begin;
+    const char* last = reinterpret_cast<const char*>(file.data()) + end;
+
+    const Board startPosition;
+    Board board = startPosition;
+    bool inGame = false;
+    bool inMovetext = false;
+    bool failed = false;
+    bool customStart = false;
+
+    auto finishGame = [&](GameResult result) {
+        if (!inGame)
+            return;
+
+        if (visitor)
+        {
+            if (failed || customStart)
+                visitor->onGameError();
+            else
+                visitor->onGameEnd(result);
+        }
+
+        stats.games++;
+        stats.errors += failed;
+        stats.skipped += customStart;
+
+        board = startPosition;
+        inGame = inMovetext = failed = customStart = false;
+    };
+
+    while (p < last)
+    {
+        char c = *p;
+
+        if (isSpace(c))
+        {
+            p++;
+        }
+        else if (c == '[')
+        {
+            // A tag after movetext means the previous game had no result token
+            if (inMovetext)
+                finishGame(GameResult::UNKNOWN);
+            inGame = true;
+            if (last - p > 5 && std::memcmp(p, "[FEN ", 5) == 0)
+                customStart = true;
+            p = skipPast(p, last, '\n');
+        }
+        else if (c == '{')
+        {
+            p = skipPast(p, last, '}');
+        }
+        else if (c == ';' || c == '%')
+        {
+            p = skipPast(p, last, '\n');
+        }
+        else if (c == '(')
+        {
+            // Variations are skipped, they may nest and contain comments
+            int depth = 0;
+            while (p < last)
+            {
+                if (*p == '{')
+                {
+                    p = skipPast(p, last, '}');
+                    continue;
+                }
+                if (*p == '(')
+                    depth++;
+                else if (*p == ')' && --depth == 0)
+                {
+                    p++;
+                    break;
+                }
+                p++;
+            }
+        }
+        else if (c == '$')
+        {
+            p++;
+            while (p < last && *p >= '0' && *p <= '9')
+                p++;
+        }
+        else if (c == ')' || c == '}')
+        {
+            p++;
+        }
+        else
+        {
+            const char* tokenBegin = p;
+            while (p < last && !isTokenEnd(*p))
+                p++;
+            const char* tokenEnd = p;
+
+            GameResult result = GameResult::UNKNOWN;
+            if (tokenIs(tokenBegin, tokenEnd, "1-0"))
+                result = GameResult::WHITEWIN;
+            else if (tokenIs(tokenBegin, tokenEnd, "0-1"))
+                result = GameResult::BLACKWIN;
+            else if (tokenIs(tokenBegin, tokenEnd, "1/2-1/2"))
+                result = GameResult::DRAW;
+
+            if (result != GameResult::UNKNOWN || tokenIs(tokenBegin, tokenEnd, "*"))
+            {
+                inGame = true;
+                finishGame(result);
+                continue;
+            }
+
+            // Move numbers ("12." or "12...") may be glued to the move itself
+            if (c >= '0' && c <= '9' && !tokenIs(tokenBegin, tokenEnd, "0-0") &&
+                !tokenIs(tokenBegin, tokenEnd, "0-0-0"))
+            {
+                while (tokenBegin < tokenEnd && ((*tokenBegin >= '0' && *tokenBegin <= '9') || *tokenBegin == '.'))
+                    tokenBegin++;
+            }
+
+            if (tokenBegin == tokenEnd || tokenIs(tokenBegin, tokenEnd, "e.p."))
+                continue;
+
+            inGame = inMovetext = true;
+            if (failed || customStart)
+                continue;
+
+            MoveList legal;
+            board.legalMoves(legal);
+
+            Move move;
+            if (matchSan(board, legal, tokenBegin, tokenEnd, move))
+            {
+                if (visitor)
+                    visitor->onMove(board, move);
+                board.makeMove(move);
+                stats.moves++;
+            }
+            else
+            {
+                failed = true;
+            }
+        }
+    }
+
+    finishGame(GameResult::UNKNOWN);
+}
+
+ReplayStats PgnReader::replay(int threads, ReplayVisitor* const* visitors) const
+{
+    ReplayStats total;
+    if (!file.isOpen())
+        return total;
+
+    if (threads < 1)
+        threads = 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // More chunks than threads keeps the workers busy when game lengths vary.
+    // A chunk is a rough byte range; its worker skips to the first game
+    // starting inside it and reads past its end to finish the last one
+    size_t chunkCount = static_cast<size_t>(threads) * 16;
+    size_t chunkSize = std::max<size_t>(file.size() / chunkCount, 1 << 16);
+    chunkCount = (file.size() + chunkSize - 1) / chunkSize;
+
+    std::atomic<size_t> nextChunk{0};
+    std::vector<ReplayStats> partial(threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+            {
+                size_t begin = nextGameStart(chunk * chunkSize);
+                size_t end = nextGameStart(std::min((chunk + 1) * chunkSize, file.size()));
+                if (begin < end)
+                    replayChunk(begin, end, partial[t], visitors ? visitors[t] : nullptr);
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto& stats : partial)
+    {
+        total.games += stats.games;
+        total.moves += stats.moves;
+        total.errors += stats.errors;
+        total.skipped += stats.skipped;
+    }
+
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
@@ -0,0 +1,65 @@
+//
+//  PgnReader.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef PgnReader_hpp
+#define PgnReader_hpp
+
+#include "Board.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+
+struct ReplayStats
+{
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t errors = 0;    // games containing a move the rules reject
+    uint64_t skipped = 0;   // games starting from a [FEN] position
+    double seconds = 0;
+};
+
+enum class GameResult
+{
+    WHITEWIN,
+    DRAW,
+    BLACKWIN,
+    UNKNOWN
+};
+
+// Receives the replayed games of one worker thread. Games that hit an illegal
+// move or start from a [FEN] tag end with onGameError instead of onGameEnd.
+class ReplayVisitor
+{
+public:
+    virtual ~ReplayVisitor() = default;
+    
+    virtual void onMove(const Board& before, const Move& move) = 0;
+    virtual void onGameEnd(GameResult result) = 0;
+    virtual void onGameError() {}
+};
+
+// Replays PGN archives on Board. The file is memory-mapped and split into byte
+// ranges that worker threads pick up one at a time, each worker resyncing to
+// the first game that starts in its range; SAN tokens are matched in place
+// against the generated legal moves.
+class PgnReader
+{
+    MappedFile file;
+
+    size_t nextGameStart(size_t offset) const;
+    void replayChunk(size_t begin, size_t end, ReplayStats& stats, ReplayVisitor* visitor) const;
+public:
+    bool open(const char* path);
+    
+    // visitors, when given, holds one visitor per thread
+    ReplayStats replay(int threads, ReplayVisitor* const* visitors = nullptr) const;
+
+    static bool matchSan(const Board& board, const MoveList& legal,
+                         const char* begin, const char* end, Move& move);
+};
+
+#endif /* PgnReader_hpp */
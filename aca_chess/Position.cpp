@@ -0,0 +1,345 @@
+//
+//  Position.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Position.hpp"
+#include "Attacks.hpp"
+#include "Zobrist.hpp"
+
+#include <cstdlib>
+
+namespace
+{
+    enum PieceType
+    {
+        PAWN,
+        ROOK,
+        BISHOP,
+        KNIGHT,
+        QUEEN,
+        KING
+    };
+
+    int pieceType(Piece piece) { return ((int)piece - 1) % 6; }
+
+    // Castling rights kept when a move starts or ends on a square, the king and
+    // rook home squares clear their rights
+    struct RightsTable
+    {
+        uint8_t kept[64];
+
+        RightsTable()
+        {
+            for (int square = 0; square < 64; square++)
+                kept[square] = 0xff;
+
+            kept[3] = static_cast<uint8_t>(~(WHITE_OO | WHITE_OOO));    // e1
+            kept[0] = static_cast<uint8_t>(~WHITE_OO);                  // h1
+            kept[7] = static_cast<uint8_t>(~WHITE_OOO);                 // a1
+            kept[59] = static_cast<uint8_t>(~(BLACK_OO | BLACK_OOO));   // e8
+            kept[56] = static_cast<uint8_t>(~BLACK_OO);                 // h8
+            kept[63] = static_cast<uint8_t>(~BLACK_OOO);                // a8
+        }
+    };
+
+    const RightsTable rights;
+}
+
+void Position::fromBoard(const Board& board, Position& position) noexcept
+{
+    position = Position{};
+    for (int code = (int)Piece::WHITEPAWN; code <= (int)Piece::BLACKKING; code++)
+    {
+        uint64_t bits = board.getBitboard(static_cast<Piece>(code));
+        position.pieces[pieceType(static_cast<Piece>(code))] |= bits;
+        if (code <= (int)Piece::WHITEKING)
+            position.white |= bits;
+    }
+
+    position.whiteToMove = board.isWhiteToMove();
+    position.castlingRights = board.getCastlingRights();
+    position.enPassantCol = static_cast<int8_t>(board.getEnPassantCol());
+}
+
+void Position::toBoard(Board& board) const noexcept
+{
+    uint64_t black = occupancy() & ~white;
+
+    board.positionWhitePawn = pieces[PAWN] & white;
+    board.positionWhiteRook = pieces[ROOK] & white;
+    board.positionWhiteBishop = pieces[BISHOP] & white;
+    board.positionWhiteKnight = pieces[KNIGHT] & white;
+    board.positionWhiteQueen = pieces[QUEEN] & white;
+    board.positionWhiteKing = pieces[KING] & white;
+    board.positionBlackPawn = pieces[PAWN] & black;
+    board.positionBlackRook = pieces[ROOK] & black;
+    board.positionBlackBishop = pieces[BISHOP] & black;
+    board.positionBlackKnight = pieces[KNIGHT] & black;
+    board.positionBlackQueen = pieces[QUEEN] & black;
+    board.positionBlackKing = pieces[KING] & black;
+
+    board.whiteToMove = whiteToMove;
+    board.castlingRights = castlingRights;
+    board.enPassantCol = enPassantCol;
+}
+
+uint64_t Position::getBitboard(Piece piece) const noexcept
+{
+    if (piece == Piece::NONE)
+        return 0;
+
+    uint64_t side = (int)piece <= (int)Piece::WHITEKING ? white : ~white;
+    return pieces[pieceType(piece)] & side;
+}
+
+Piece Position::pieceAt(int square) const noexcept
+{
+    uint64_t bit = 1ULL << square;
+    for (int type = PAWN; type <= KING; type++)
+        if (pieces[type] & bit)
+            return static_cast<Piece>(type + 1 + ((white & bit) ? 0 : 6));
+
+    return Piece::NONE;
+}
+
+Move Position::unpackMove(uint16_t packed) const noexcept
+{
+    Move move;
+    move.from = packed & 63;
+    move.to = (packed >> 6) & 63;
+    move.flags = MOVE_QUIET;
+
+    uint64_t fromBit = 1ULL << move.from;
+    bool isWhite = !(occupancy() & fromBit) || (white & fromBit);
+
+    int type = packed >> 12;
+    move.promotion = type ? static_cast<Piece>(type + 1 + (isWhite ? 0 : 6)) : Piece::NONE;
+
+    if (occupancy() & (1ULL << move.to))
+        move.flags |= MOVE_CAPTURE;
+
+    int colFrom = Attacks::col(move.from), colTo = Attacks::col(move.to);
+    if (pieces[PAWN] & fromBit)
+    {
+        if (colFrom != colTo && !(move.flags & MOVE_CAPTURE))
+            move.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+        if (std::abs(Attacks::row(move.to) - Attacks::row(move.from)) == 2)
+            move.flags |= MOVE_DOUBLE_PUSH;
+    }
+    else if ((pieces[KING] & fromBit) && std::abs(colTo - colFrom) == 2)
+    {
+        move.flags |= MOVE_CASTLE;
+    }
+
+    return move;
+}
+
+bool Position::isSquareAttacked(int square, bool byWhite) const noexcept
+{
+    uint64_t occupied = occupancy();
+    uint64_t them = byWhite ? white : occupied & ~white;
+
+    return (Attacks::pawn(square, !byWhite) & pieces[PAWN] & them) ||
+           (Attacks::knight(square) & pieces[KNIGHT] & them) ||
+           (Attacks::king(square) & pieces[KING] & them) ||
+           (Attacks::rook(square, occupied) & (pieces[ROOK] | pieces[QUEEN]) & them) ||
+           (Attacks::bishop(square, occupied) & (pieces[BISHOP] | pieces[QUEEN]) & them);
+}
+
+bool Position::inCheck() const noexcept
+{
+    uint64_t king = pieces[KING] & (whiteToMove ? white : ~white);
+    return king && isSquareAttacked(__builtin_ctzll(king), !whiteToMove);
+}
+
+void Position::pseudoMoves(MoveList& list, uint8_t kinds) const noexcept
+{
+    bool isWhite = whiteToMove;
+    uint64_t occupied = occupancy();
+    uint64_t own = isWhite ? white : occupied & ~white;
+    uint64_t enemy = occupied & ~own;
+
+    int forward = isWhite ? 8 : -8;
+    int startRow = isWhite ? 1 : 6;
+    int lastRow = isWhite ? 7 : 0;
+    int epRow = isWhite ? 4 : 3;
+
+    const Piece whitePromotions[4] = {Piece::WHITEQUEEN, Piece::WHITEROOK, Piece::WHITEBISHOP, Piece::WHITEKNIGHT};
+    const Piece blackPromotions[4] = {Piece::BLACKQUEEN, Piece::BLACKROOK, Piece::BLACKBISHOP, Piece::BLACKKNIGHT};
+    const Piece* promotions = isWhite ? whitePromotions : blackPromotions;
+
+    bool noisy = kinds & MOVES_NOISY;
+    bool quiet = kinds & MOVES_QUIET;
+
+    auto addPawnMove = [&](int from, int to, uint8_t flags) {
+        if (Attacks::row(to) == lastRow)
+        {
+            for (int i = 0; noisy && i < 4; i++)
+                list.push(from, to, flags, promotions[i]);
+        }
+        else if (quiet || (flags & MOVE_CAPTURE))
+            list.push(from, to, flags);
+    };
+
+    for (uint64_t pawns = pieces[PAWN] & own; pawns; pawns &= pawns - 1)
+    {
+        int from = __builtin_ctzll(pawns);
+        int to = from + forward;
+        if (!(occupied & (1ULL << to)))
+        {
+            addPawnMove(from, to, MOVE_QUIET);
+            if (quiet && Attacks::row(from) == startRow && !(occupied & (1ULL << (to + forward))))
+                list.push(from, to + forward, MOVE_DOUBLE_PUSH);
+        }
+
+        for (uint64_t captures = noisy ? Attacks::pawn(from, isWhite) & enemy : 0; captures; captures &= captures - 1)
+            addPawnMove(from, __builtin_ctzll(captures), MOVE_CAPTURE);
+
+        if (noisy && enPassantCol >= 0 && Attacks::row(from) == epRow)
+        {
+            int epSquare = Attacks::square(epRow + (isWhite ? 1 : -1), enPassantCol);
+            if (Attacks::pawn(from, isWhite) & (1ULL << epSquare))
+                list.push(from, epSquare, MOVE_CAPTURE | MOVE_EN_PASSANT);
+        }
+    }
+
+    uint64_t wanted = (noisy ? enemy : 0) | (quiet ? ~occupied : 0);
+    auto addTargets = [&](int from, uint64_t targets) {
+        for (targets &= wanted; targets; targets &= targets - 1)
+        {
+            int to = __builtin_ctzll(targets);
+            list.push(from, to, (enemy & (1ULL << to)) ? MOVE_CAPTURE : MOVE_QUIET);
+        }
+    };
+
+    for (uint64_t knights = pieces[KNIGHT] & own; knights; knights &= knights - 1)
+        addTargets(__builtin_ctzll(knights), Attacks::knight(__builtin_ctzll(knights)));
+
+    for (uint64_t bishops = pieces[BISHOP] & own; bishops; bishops &= bishops - 1)
+        addTargets(__builtin_ctzll(bishops), Attacks::bishop(__builtin_ctzll(bishops), occupied));
+
+    for (uint64_t rooks = pieces[ROOK] & own; rooks; rooks &= rooks - 1)
+        addTargets(__builtin_ctzll(rooks), Attacks::rook(__builtin_ctzll(rooks), occupied));
+
+    for (uint64_t queens = pieces[QUEEN] & own; queens; queens &= queens - 1)
+        addTargets(__builtin_ctzll(queens), Attacks::queen(__builtin_ctzll(queens), occupied));
+
+    uint64_t king = pieces[KING] & own;
+    if (!king)
+        return;
+
+    int kingSquare = __builtin_ctzll(king);
+    addTargets(kingSquare, Attacks::king(kingSquare));
+    if (!quiet)
+        return;
+
+    int row = isWhite ? 0 : 7;
+    uint8_t shortRight = isWhite ? WHITE_OO : BLACK_OO;
+    uint8_t longRight = isWhite ? WHITE_OOO : BLACK_OOO;
+
+    auto empty = [&](int col) { return !(occupied & (1ULL << Attacks::square(row, col))); };
+    auto safe = [&](int col) { return !isSquareAttacked(Attacks::square(row, col), !isWhite); };
+
+    if ((castlingRights & shortRight) && empty(5) && empty(6) && safe(4) && safe(5) && safe(6))
+        list.push(kingSquare, Attacks::square(row, 6), MOVE_CASTLE);
+
+    if ((castlingRights & longRight) && empty(1) && empty(2) && empty(3) && safe(4) && safe(3) && safe(2))
+        list.push(kingSquare, Attacks::square(row, 2), MOVE_CASTLE);
+}
+
+void Position::legalMoves(MoveList& list) const noexcept
+{
+    MoveList pseudo;
+    pseudoMoves(pseudo);
+
+    Position next;
+    for (int i = 0; i < pseudo.count; i++)
+        if (makeMove(pseudo.moves[i], next))
+            list.moves[list.count++] = pseudo.moves[i];
+}
+
+bool Position::hasLegalMove() const noexcept
+{
+    // The king usually has a safe step, which settles it without generating moves
+    Position next;
+    uint64_t own = whiteToMove ? white : occupancy() & ~white;
+    uint64_t king = pieces[KING] & own;
+    if (king)
+    {
+        int from = __builtin_ctzll(king);
+        for (uint64_t steps = Attacks::king(from) & ~own; steps; steps &= steps - 1)
+            if (makeMove({static_cast<uint8_t>(from), static_cast<uint8_t>(__builtin_ctzll(steps)), Piece::NONE, MOVE_QUIET}, next))
+                return true;
+    }
+
+    MoveList pseudo;
+    pseudoMoves(pseudo);
+
+    for (int i = 0; i < pseudo.count; i++)
+        if (makeMove(pseudo.moves[i], next))
+            return true;
+    return false;
+}
+
+bool Position::makeMove(const Move& move, Position& next) const noexcept
+{
+    uint64_t fromBit = 1ULL << move.from;
+    uint64_t toBit = 1ULL << move.to;
+    bool isWhite = whiteToMove;
+
+    int type = PAWN;
+    while (type < KING && !(pieces[type] & fromBit))
+        type++;
+
+    next = *this;
+
+    // A capture clears whatever stood on the target square
+    for (int t = PAWN; t <= KING; t++)
+        next.pieces[t] &= ~toBit;
+    next.white &= ~toBit;
+
+    if (move.flags & MOVE_EN_PASSANT)
+    {
+        uint64_t victim = 1ULL << Attacks::square(Attacks::row(move.from), Attacks::col(move.to));
+        next.pieces[PAWN] &= ~victim;
+        next.white &= ~victim;
+    }
+
+    next.pieces[type] &= ~fromBit;
+    next.pieces[move.promotion != Piece::NONE ? pieceType(move.promotion) : type] |= toBit;
+    if (isWhite)
+        next.white = (next.white & ~fromBit) | toBit;
+
+    if (move.flags & MOVE_CASTLE)
+    {
+        int row = Attacks::row(move.to);
+        bool kingSide = Attacks::col(move.to) == 6;
+        uint64_t rookMove = (1ULL << Attacks::square(row, kingSide ? 7 : 0)) |
+                            (1ULL << Attacks::square(row, kingSide ? 5 : 3));
+        next.pieces[ROOK] ^= rookMove;
+        if (isWhite)
+            next.white ^= rookMove;
+    }
+
+    next.enPassantCol = (move.flags & MOVE_DOUBLE_PUSH) ? static_cast<int8_t>(Attacks::col(move.from)) : -1;
+    next.castlingRights &= rights.kept[move.from] & rights.kept[move.to];
+    next.whiteToMove = !isWhite;
+
+    uint64_t king = next.pieces[KING] & (isWhite ? next.white : ~next.white);
+    return !king || !next.isSquareAttacked(__builtin_ctzll(king), !isWhite);
+}
+
+bool Position::makeMove(const Move& move, Position& next, uint64_t& key) const noexcept
+{
+    Piece moved = pieceAt(move.from);
+    Piece captured = (move.flags & MOVE_EN_PASSANT) ? Piece::NONE : pieceAt(move.to);
+    if (!makeMove(move, next))
+        return false;
+
+    key ^= Zobrist::enPassantTerm(*this) ^ Zobrist::moveKey(move, moved, captured, castlingRights ^ next.castlingRights) ^
+           Zobrist::enPassantTerm(next);
+    return true;
+}
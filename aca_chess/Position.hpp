@@ -0,0 +1,57 @@
+//
+//  Position.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Position_hpp
+#define Position_hpp
+
+#include "Board.hpp"
+
+#include <cstdint>
+
+// One cache line holding everything the search needs from a Board: a bitboard
+// per piece type, the white pieces and the game state. Moves are made by
+// writing the child into the next slot of a per-ply stack, so nothing is ever
+// undone and each search thread owns its positions outright.
+struct alignas(64) Position
+{
+    uint64_t pieces[6];     // by type in Piece order: pawn, rook, bishop, knight, queen, king
+    uint64_t white;
+    bool whiteToMove;
+    uint8_t castlingRights;
+    int8_t enPassantCol;
+    uint8_t reserved[5];
+
+    static void fromBoard(const Board& board, Position& position) noexcept;
+    void toBoard(Board& board) const noexcept;
+
+    uint64_t occupancy() const noexcept { return pieces[0] | pieces[1] | pieces[2] | pieces[3] | pieces[4] | pieces[5]; }
+    uint64_t getBitboard(Piece piece) const noexcept;
+    Piece pieceAt(int square) const noexcept;
+    bool isWhiteToMove() const noexcept { return whiteToMove; }
+    uint8_t getCastlingRights() const noexcept { return castlingRights; }
+    int getEnPassantCol() const noexcept { return enPassantCol; }
+    Move unpackMove(uint16_t packed) const noexcept;
+
+    bool isSquareAttacked(int square, bool byWhite) const noexcept;
+    bool inCheck() const noexcept;
+
+    void pseudoMoves(MoveList& list, uint8_t kinds = MOVES_ALL) const noexcept;
+    void legalMoves(MoveList& list) const noexcept;
+    // Stops at the first legal move instead of checking them all
+    bool hasLegalMove() const noexcept;
+
+    // Writes the position after move to next, returns false when the move
+    // leaves the mover's king attacked
+    bool makeMove(const Move& move, Position& next) const noexcept;
+    // Also updates key, the Zobrist key of this position, to the key of next.
+    // key is left alone when the move is refused
+    bool makeMove(const Move& move, Position& next, uint64_t& key) const noexcept;
+};
+
+static_assert(sizeof(Position) == 64, "Position must fit one cache line");
+
+#endif /* Position_hpp */
@@ -0,0 +1,401 @@
+//
+//  PositionIndex.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "PositionIndex.hpp"
+#include "PgnReader.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <vector>
+
+namespace
+{
+    constexpr char MAGIC[8] = {'A', 'C', 'A', 'I', 'D', 'X', '2', '\0'};
+    constexpr size_t HEADER_SIZE = 24;
+    constexpr size_t ENTRY_SIZE = 24;
+    constexpr size_t MERGE_FAN_IN = 64;
+
+    struct Record
+    {
+        uint64_t key;
+        uint16_t move;
+        GameResult result;
+    };
+
+    void putLittleEndian(uint8_t* p, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    uint64_t getLittleEndian(const uint8_t* p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--)
+            value = (value << 8) | p[i];
+        return value;
+    }
+
+    // Identifies the key table, whose keys an index is only valid under
+    uint64_t keyFingerprint()
+    {
+        return Zobrist::polyglotKey(Board());
+    }
+
+    void writeEntry(std::ofstream& out, const IndexEntry& entry)
+    {
+        uint8_t bytes[ENTRY_SIZE] = {};
+        putLittleEndian(bytes, entry.key, 8);
+        putLittleEndian(bytes + 8, entry.move, 2);
+        putLittleEndian(bytes + 12, entry.whiteWins, 4);
+        putLittleEndian(bytes + 16, entry.draws, 4);
+        putLittleEndian(bytes + 20, entry.blackWins, 4);
+        out.write(reinterpret_cast<const char*>(bytes), ENTRY_SIZE);
+    }
+
+    IndexEntry readEntry(const uint8_t* bytes)
+    {
+        IndexEntry entry;
+        entry.key = getLittleEndian(bytes, 8);
+        entry.move = static_cast<uint16_t>(getLittleEndian(bytes + 8, 2));
+        entry.whiteWins = static_cast<uint32_t>(getLittleEndian(bytes + 12, 4));
+        entry.draws = static_cast<uint32_t>(getLittleEndian(bytes + 16, 4));
+        entry.blackWins = static_cast<uint32_t>(getLittleEndian(bytes + 20, 4));
+        return entry;
+    }
+
+    bool sameSlot(const IndexEntry& a, const IndexEntry& b)
+    {
+        return a.key == b.key && a.move == b.move;
+    }
+
+    void accumulate(IndexEntry& into, const IndexEntry& from)
+    {
+        into.whiteWins += from.whiteWins;
+        into.draws += from.draws;
+        into.blackWins += from.blackWins;
+    }
+
+    class IndexVisitor : public ReplayVisitor
+    {
+        std::string runPrefix;
+        size_t recordsPerRun;
+
+        std::vector<std::pair<uint64_t, uint16_t>> game;
+        std::vector<Record> records;
+    public:
+        std::vector<std::string> runs;
+        bool failed = false;
+
+        IndexVisitor(std::string prefix, size_t limit) : runPrefix(std::move(prefix)), recordsPerRun(limit)
+        {
+            records.reserve(limit);
+        }
+
+        void onMove(const Board& before, const Move& move) override
+        {
+            game.emplace_back(Zobrist::polyglotKey(before), move.pack());
+        }
+
+        void onGameEnd(GameResult result) override
+        {
+            if (result != GameResult::UNKNOWN)
+                for (const auto& [key, move] : game)
+                    records.push_back({key, move, result});
+            game.clear();
+
+            if (records.size() >= recordsPerRun)
+                flush();
+        }
+
+        void onGameError() override
+        {
+            game.clear();
+        }
+
+        // Sorts the buffered records and writes them aggregated as one run
+        void flush()
+        {
+            if (records.empty())
+                return;
+
+            std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+                return a.key != b.key ? a.key < b.key : a.move < b.move;
+            });
+
+            std::string path = runPrefix + std::to_string(runs.size());
+            std::ofstream out(path, std::ios::binary);
+
+            IndexEntry current{records[0].key, records[0].move, 0, 0, 0};
+            for (const Record& record : records)
+            {
+                if (record.key != current.key || record.move != current.move)
+                {
+                    writeEntry(out, current);
+                    current = {record.key, record.move, 0, 0, 0};
+                }
+
+                if (record.result == GameResult::WHITEWIN)
+                    current.whiteWins++;
+                else if (record.result == GameResult::DRAW)
+                    current.draws++;
+                else
+                    current.blackWins++;
+            }
+            writeEntry(out, current);
+            out.close();
+
+            runs.push_back(path);
+            records.clear();
+            if (!out)
+                failed = true;
+        }
+    };
+
+    class RunReader
+    {
+        std::ifstream in;
+    public:
+        IndexEntry current;
+
+        explicit RunReader(const std::string& path) : in(path, std::ios::binary) {}
+
+        bool next()
+        {
+            uint8_t bytes[ENTRY_SIZE];
+            if (!in.read(reinterpret_cast<char*>(bytes), ENTRY_SIZE))
+                return false;
+            current = readEntry(bytes);
+            return true;
+        }
+
+        // Whether next() stopped at the clean end of the run rather than on an error
+        bool finished() const
+        {
+            return in.eof() && in.gcount() == 0;
+        }
+    };
+
+    void removeRuns(const std::vector<std::string>& paths)
+    {
+        for (const auto& path : paths)
+            std::remove(path.c_str());
+    }
+
+    // k-way merge of sorted runs, combining equal (key, move) slots. Returns
+    // false if a run could not be read to its end or the output failed
+    bool mergeRuns(const std::vector<std::string>& paths, std::ofstream& out, uint64_t& written)
+    {
+        std::vector<RunReader> runs;
+        runs.reserve(paths.size());
+        for (const auto& path : paths)
+            runs.emplace_back(path);
+
+        auto later = [&](size_t a, size_t b) {
+            const IndexEntry& x = runs[a].current;
+            const IndexEntry& y = runs[b].current;
+            return x.key != y.key ? x.key > y.key : x.move > y.move;
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+        for (size_t i = 0; i < runs.size(); i++)
+            if (runs[i].next())
+                heap.push(i);
+
+        written = 0;
+        bool haveCurrent = false;
+        IndexEntry current{};
+
+        while (!heap.empty())
+        {
+            size_t run = heap.top();
+            heap.pop();
+
+            if (haveCurrent && sameSlot(current, runs[run].current))
+            {
+                accumulate(current, runs[run].current);
+            }
+            else
+            {
+                if (haveCurrent)
+                {
+                    writeEntry(out, current);
+                    written++;
+                }
+                current = runs[run].current;
+                haveCurrent = true;
+            }
+
+            if (runs[run].next())
+                heap.push(run);
+        }
+
+        if (haveCurrent)
+        {
+            writeEntry(out, current);
+            written++;
+        }
+
+        for (const auto& run : runs)
+            if (!run.finished())
+                return false;
+        return out.good();
+    }
+}
+
+PositionIndexBuilder::PositionIndexBuilder(std::string path, size_t recordsPerRun)
+    : outputPath(std::move(path)), recordsPerRun(recordsPerRun)
+{
+}
+
+bool PositionIndexBuilder::build(const char* pgnPath, int threads, uint64_t& entries)
+{
+    entries = 0;
+
+    PgnReader reader;
+    if (!reader.open(pgnPath))
+        return false;
+
+    threads = std::max(threads, 1);
+
+    std::vector<IndexVisitor> visitors;
+    std::vector<ReplayVisitor*> pointers;
+    visitors.reserve(threads);
+    for (int t = 0; t < threads; t++)
+        visitors.emplace_back(outputPath + ".run" + std::to_string(t) + "-", recordsPerRun);
+    for (auto& visitor : visitors)
+        pointers.push_back(&visitor);
+
+    reader.replay(threads, pointers.data());
+
+    std::vector<std::string> runPaths;
+    bool failed = false;
+    for (auto& visitor : visitors)
+    {
+        visitor.flush();
+        runPaths.insert(runPaths.end(), visitor.runs.begin(), visitor.runs.end());
+        failed |= visitor.failed;
+    }
+
+    if (failed)
+    {
+        removeRuns(runPaths);
+        return false;
+    }
+
+    // Runs are merged at most MERGE_FAN_IN at a time, so the number of open
+    // files stays bounded however many runs the archive produced
+    for (int pass = 0; runPaths.size() > MERGE_FAN_IN; pass++)
+    {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runPaths.size() && !failed; first += MERGE_FAN_IN)
+        {
+            size_t last = std::min(first + MERGE_FAN_IN, runPaths.size());
+            std::vector<std::string> group(runPaths.begin() + first, runPaths.begin() + last);
+
+            merged.push_back(outputPath + ".merge" + std::to_string(pass) + "-" + std::to_string(merged.size()));
+            std::ofstream out(merged.back(), std::ios::binary);
+            uint64_t written;
+            failed = !mergeRuns(group, out, written);
+            out.close();
+            failed |= !out;
+        }
+
+        removeRuns(runPaths);
+        if (failed)
+        {
+            removeRuns(merged);
+            return false;
+        }
+        runPaths = std::move(merged);
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    uint8_t header[HEADER_SIZE] = {};
+    out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+
+    uint64_t written = 0;
+    failed = !mergeRuns(runPaths, out, written);
+
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    putLittleEndian(header + 8, written, 8);
+    putLittleEndian(header + 16, keyFingerprint(), 8);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+    out.close();
+
+    removeRuns(runPaths);
+    if (failed || !out)
+    {
+        std::remove(outputPath.c_str());
+        return false;
+    }
+
+    entries = written;
+    return true;
+}
+
+bool PositionIndex::open(const char* path)
+{
+    if (!file.open(path))
+        return false;
+
+    // The count comes from the file, so it is compared without multiplying it
+    if (file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+        getLittleEndian(file.data() + 16, 8) != keyFingerprint() ||
+        (file.size() - HEADER_SIZE) % ENTRY_SIZE != 0 || entryCount() != (file.size() - HEADER_SIZE) / ENTRY_SIZE)
+    {
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t PositionIndex::entryCount() const
+{
+    return getLittleEndian(file.data() + 8, 8);
+}
+
+IndexEntry PositionIndex::entryAt(uint64_t index) const
+{
+    return readEntry(file.data() + HEADER_SIZE + index * ENTRY_SIZE);
+}
+
+int PositionIndex::lookup(const Board& board, IndexEntry* entries, int maxEntries) const
+{
+    if (!isOpen())
+        return 0;
+
+    uint64_t key = Zobrist::polyglotKey(board);
+    uint64_t count = entryCount();
+
+    uint64_t lo = 0, hi = count;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (getLittleEndian(file.data() + HEADER_SIZE + mid * ENTRY_SIZE, 8) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    int found = 0;
+    for (uint64_t i = lo; i < count; i++, found++)
+    {
+        IndexEntry entry = entryAt(i);
+        if (entry.key != key)
+            break;
+        if (found < maxEntries)
+            entries[found] = entry;
+    }
+
+    return found;
+}
@@ -0,0 +1,62 @@
+//
+//  PositionIndex.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef PositionIndex_hpp
+#define PositionIndex_hpp
+
+#include "Board.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <string>
+
+// One (position, move) pair of the index with the results of the games that
+// played it. On disk every entry takes 24 little-endian bytes, sorted by key
+// and then by move, after a 24-byte header ("ACAIDX2", the entry count and the
+// start-position key of the key table the index was built with).
+struct IndexEntry
+{
+    uint64_t key;
+    uint16_t move;      // Move::pack()
+    uint32_t whiteWins;
+    uint32_t draws;
+    uint32_t blackWins;
+};
+
+// Builds an index from a PGN archive. Every thread collects (key, move,
+// result) records, sorts and aggregates them into a run file whenever its
+// buffer fills up, and the runs are merged into the final file at the end, at
+// most 64 at a time, so the number of positions is bounded by disk space rather
+// than memory.
+class PositionIndexBuilder
+{
+    std::string outputPath;
+    size_t recordsPerRun;
+public:
+    explicit PositionIndexBuilder(std::string path, size_t recordsPerRun = 1 << 22);
+
+    // Stores the number of distinct (position, move) entries written. Returns
+    // false if the archive could not be read or a run or the index could not
+    // be written, in which case no index is left behind
+    bool build(const char* pgnPath, int threads, uint64_t& entries);
+};
+
+class PositionIndex
+{
+    MappedFile file;
+
+    uint64_t entryCount() const;
+    IndexEntry entryAt(uint64_t index) const;
+public:
+    bool open(const char* path);
+    bool isOpen() const { return file.isOpen(); }
+
+    // Writes up to maxEntries moves played from the position, returns how many exist
+    int lookup(const Board& board, IndexEntry* entries, int maxEntries) const;
+};
+
+#endif /* PositionIndex_hpp */
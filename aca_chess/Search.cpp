@@ -0,0 +1,441 @@
+//
+//  Search.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Search.hpp"
+#include "Invariants.hpp"
+#include "Zobrist.hpp"
+#include "Cpu.hpp"
+
+#ifdef ACA_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Indexed by Piece
+    const int pieceValues[13] = {0, 100, 500, 330, 320, 900, 0, 100, 500, 330, 320, 900, 0};
+
+    // d4, e4, d5, e5, pawns and minor pieces standing here get a small bonus
+    constexpr uint64_t CENTER = 0x0000001818000000ULL;
+
+    // Both backends expose the position being searched through the same calls.
+    // make takes pseudo-legal moves and refuses the ones leaving the king in
+    // check, so legality is only paid for moves that are actually tried. The
+    // key is computed once at the root and updated by every move
+    class MakeUnmakeBackend
+    {
+        Board board;
+        UndoInfo undo[Search::MAX_PLY];
+        int ply = 0;
+        uint64_t hash;
+    public:
+        using PositionType = Board;
+
+        explicit MakeUnmakeBackend(const Board& root) : board(root), hash(Zobrist::polyglotKey(root)) {}
+
+        const Board& current() const { return board; }
+        uint64_t key() const { return hash; }
+        bool hasLegalMove() const { return board.hasLegalMove(); }
+        bool inCheck() const { return board.inCheck(); }
+        bool isLegal(const Move& move) const
+        {
+            return MovePicker<Board>::isPseudoLegal(board, move) && board.leavesKingSafe(move);
+        }
+
+        bool make(const Move& move)
+        {
+            if (!board.leavesKingSafe(move))
+                return false;
+            board.makeMove(move, undo[ply++], hash);
+            return true;
+        }
+        void unmake(const Move& move) { board.unmakeMove(move, undo[--ply], hash); }
+    };
+
+    class CopyMakeBackend
+    {
+        Position stack[Search::MAX_PLY + 1];
+        uint64_t keys[Search::MAX_PLY + 1];
+        int ply = 0;
+    public:
+        using PositionType = Position;
+
+        explicit CopyMakeBackend(const Board& root)
+        {
+            Position::fromBoard(root, stack[0]);
+            keys[0] = Zobrist::polyglotKey(root);
+        }
+
+        const Position& current() const { return stack[ply]; }
+        uint64_t key() const { return keys[ply]; }
+        bool hasLegalMove() const { return stack[ply].hasLegalMove(); }
+        bool inCheck() const { return stack[ply].inCheck(); }
+        bool isLegal(const Move& move) const
+        {
+            Position next;
+            return MovePicker<Position>::isPseudoLegal(stack[ply], move) && stack[ply].makeMove(move, next);
+        }
+
+        bool make(const Move& move)
+        {
+            keys[ply + 1] = keys[ply];
+            if (!stack[ply].makeMove(move, stack[ply + 1], keys[ply + 1]))
+                return false;
+            ply++;
+            return true;
+        }
+        void unmake(const Move&) { ply--; }
+    };
+
+    // Mate scores are stored relative to the node so they stay valid when the
+    // position is reached at another ply
+    int scoreToTable(int score, int ply)
+    {
+        if (score >= Search::MATE - Search::MAX_PLY * 2)
+            return score + ply;
+        if (score <= -Search::MATE + Search::MAX_PLY * 2)
+            return score - ply;
+        return score;
+    }
+
+    int scoreFromTable(int score, int ply)
+    {
+        if (score >= Search::MATE - Search::MAX_PLY * 2)
+            return score - ply;
+        if (score <= -Search::MATE + Search::MAX_PLY * 2)
+            return score + ply;
+        return score;
+    }
+
+    // Signed per-bitboard weights in Piece order (white first) for the
+    // evaluation kernels, which only differ in how they count bits
+    struct EvalWeights
+    {
+        alignas(32) int64_t material[12];
+        alignas(32) int64_t center[12];
+
+        EvalWeights()
+        {
+            for (int i = 0; i < 12; i++)
+            {
+                int sign = i < 6 ? 1 : -1;
+                int type = i % 6;
+                material[i] = sign * pieceValues[i + 1];
+                center[i] = (type == 0 || type == 2 || type == 3) ? sign * 15 : 0;
+            }
+        }
+    };
+
+    const EvalWeights weights;
+
+    __attribute__((always_inline)) inline int materialLoop(const uint64_t* boards)
+    {
+        int score = 0;
+        for (int i = 0; i < 12; i++)
+            score += static_cast<int>(weights.material[i] * __builtin_popcountll(boards[i]) +
+                                      weights.center[i] * __builtin_popcountll(boards[i] & CENTER));
+        return score;
+    }
+
+    int materialScalar(const uint64_t* boards)
+    {
+        return materialLoop(boards);
+    }
+
+#ifdef ACA_X86_DISPATCH
+    __attribute__((target("popcnt")))
+    int materialPopcnt(const uint64_t* boards)
+    {
+        return materialLoop(boards);
+    }
+
+    // Nibble table popcount of four bitboards at a time
+    __attribute__((target("avx2")))
+    inline __m256i popcount4(__m256i v)
+    {
+        const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+
+        __m256i low = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(v, lowNibbles));
+        __m256i high = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles));
+        return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+    }
+
+    __attribute__((target("avx2")))
+    int materialAvx2(const uint64_t* boards)
+    {
+        const __m256i center = _mm256_set1_epi64x(static_cast<long long>(CENTER));
+
+        __m256i total = _mm256_setzero_si256();
+        for (int i = 0; i < 12; i += 4)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(boards + i));
+            __m256i material = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights.material + i));
+            __m256i bonus = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights.center + i));
+
+            total = _mm256_add_epi64(total, _mm256_mul_epi32(popcount4(v), material));
+            total = _mm256_add_epi64(total, _mm256_mul_epi32(popcount4(_mm256_and_si256(v, center)), bonus));
+        }
+
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+        return static_cast<int>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+    }
+#endif
+
+    int materialScore(const uint64_t* boards)
+    {
+#ifdef ACA_X86_DISPATCH
+        switch (Cpu::active())
+        {
+            case Cpu::Level::AVX2:
+                return materialAvx2(boards);
+            case Cpu::Level::BMI2:
+            case Cpu::Level::POPCNT:
+                return materialPopcnt(boards);
+            default:
+                break;
+        }
+#endif
+        return materialScalar(boards);
+    }
+
+    template <typename P>
+    int evaluatePosition(const P& board)
+    {
+        uint64_t boards[12];
+        for (int i = 0; i < 12; i++)
+            boards[i] = board.getBitboard(static_cast<Piece>(i + 1));
+
+        int score = materialScore(boards);
+        return board.isWhiteToMove() ? score : -score;
+    }
+}
+
+int Search::evaluate(const Board& board) noexcept
+{
+    return evaluatePosition(board);
+}
+
+int Search::evaluate(const Position& position) noexcept
+{
+    return evaluatePosition(position);
+}
+
+bool Search::shouldStop() noexcept
+{
+    if (limits.nodes && nodes >= limits.nodes)
+        return true;
+
+    return limits.milliseconds && (nodes & 1023) == 0 && std::chrono::steady_clock::now() >= deadline;
+}
+
+template <typename Backend>
+int Search::quiesce(Backend& backend, int alpha, int beta, int ply) noexcept
+{
+    nodes++;
+    if (stopped || (stopped = shouldStop()))
+        return 0;
+    ACA_DEBUG_CHECK(backend.current());
+    ACA_DEBUG_CHECK_KEY(backend.current(), backend.key());
+
+    int standPat = evaluate(backend.current());
+    if (ply >= MAX_PLY)
+        return standPat;
+    if (standPat >= beta)
+        return standPat;
+    if (standPat > alpha)
+        alpha = standPat;
+
+    MovePicker<typename Backend::PositionType> picker(backend.current(), 0, nullptr, false);
+    Move move;
+    while (picker.next(move))
+    {
+        if (!backend.make(move))
+            continue;
+        stageMoves[(int)PickStage::CAPTURES]++;
+
+        int score = -quiesce(backend, -beta, -alpha, ply + 1);
+        backend.unmake(move);
+
+        if (stopped)
+            return 0;
+        if (score >= beta)
+        {
+            stageCutoffs[(int)PickStage::CAPTURES]++;
+            return score;
+        }
+        if (score > alpha)
+            alpha = score;
+    }
+
+    return alpha;
+}
+
+template <typename Backend>
+int Search::negamax(Backend& backend, int depth, int alpha, int beta, int ply, Move* best) noexcept
+{
+    nodes++;
+    if (stopped || (stopped = shouldStop()))
+        return 0;
+    ACA_DEBUG_CHECK(backend.current());
+    ACA_DEBUG_CHECK_KEY(backend.current(), backend.key());
+
+    if (depth == 0 || ply >= MAX_PLY)
+    {
+        // The quiescence search cannot tell mate or stalemate from a quiet
+        // position, so the game ending here is ruled out first
+        if (!backend.hasLegalMove())
+            return backend.inCheck() ? -MATE + ply : 0;
+        return quiesce(backend, alpha, beta, ply);
+    }
+
+    uint64_t key = 0;
+    TableEntry entry;
+    bool hit = false;
+    if (table)
+    {
+        key = backend.key();
+        hit = table->probe(key, entry);
+    }
+    uint16_t hashMove = hit ? entry.move : 0;
+
+    if (hit && entry.depth >= depth)
+    {
+        int score = scoreFromTable(entry.score, ply);
+        bool cutoff = entry.bound == Bound::EXACT ||
+                      (entry.bound == Bound::LOWER && score >= beta) ||
+                      (entry.bound == Bound::UPPER && score <= alpha);
+
+        if (cutoff && !best)
+            return score;
+
+        // The root also needs the move
+        if (cutoff && hashMove)
+        {
+            Move move = backend.current().unpackMove(hashMove);
+            if (backend.isLegal(move))
+            {
+                *best = move;
+                return score;
+            }
+        }
+    }
+
+    MovePicker<typename Backend::PositionType> picker(backend.current(), hashMove, killers[ply]);
+
+    int originalAlpha = alpha;
+    Move bestMove{};
+    int bestScore = -INFINITE;
+    int legal = 0;
+
+    Move move;
+    while (picker.next(move))
+    {
+        if (!backend.make(move))
+            continue;
+        legal++;
+
+        int stage = (int)picker.stageOfLast();
+        stageMoves[stage]++;
+
+        int score = -negamax(backend, depth - 1, -beta, -alpha, ply + 1, nullptr);
+        backend.unmake(move);
+
+        if (stopped)
+            return 0;
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = move;
+            if (best)
+                *best = move;
+        }
+
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta)
+        {
+            stageCutoffs[stage]++;
+            bool quiet = !(move.flags & MOVE_CAPTURE) && move.promotion == Piece::NONE;
+            if (quiet && killers[ply][0].pack() != move.pack())
+            {
+                killers[ply][1] = killers[ply][0];
+                killers[ply][0] = move;
+            }
+            break;
+        }
+    }
+
+    if (legal == 0)
+        return backend.inCheck() ? -MATE + ply : 0;
+
+    if (table)
+    {
+        Bound bound = bestScore <= originalAlpha ? Bound::UPPER : bestScore >= beta ? Bound::LOWER : Bound::EXACT;
+        table->store(key, bound == Bound::UPPER ? 0 : bestMove.pack(), scoreToTable(bestScore, ply), depth, bound);
+    }
+
+    return bestScore;
+}
+
+template <typename Backend>
+SearchResult Search::iterate(Backend& backend) noexcept
+{
+    SearchResult result;
+
+    for (int depth = 1; depth <= limits.depth; depth++)
+    {
+        Move best{};
+        int score = negamax(backend, depth, -INFINITE, INFINITE, 0, &best);
+
+        // An interrupted iteration is only used when nothing else is known
+        if (stopped && result.hasMove)
+            break;
+
+        if (best.from != best.to)
+        {
+            result.best = best;
+            result.hasMove = true;
+            result.score = score;
+            result.depth = depth;
+        }
+
+        if (stopped || result.score >= MATE - depth || (!result.hasMove && depth == 1))
+            break;
+    }
+
+    result.nodes = nodes;
+    for (int i = 0; i < PICK_STAGES; i++)
+    {
+        result.stageMoves[i] = stageMoves[i];
+        result.stageCutoffs[i] = stageCutoffs[i];
+    }
+    return result;
+}
+
+SearchResult Search::run(const Board& root, const SearchLimits& searchLimits, SearchBackend backend) noexcept
+{
+    limits = searchLimits;
+    nodes = 0;
+    stopped = false;
+    for (int i = 0; i < PICK_STAGES; i++)
+        stageMoves[i] = stageCutoffs[i] = 0;
+    for (int ply = 0; ply < MAX_PLY; ply++)
+        killers[ply][0] = killers[ply][1] = Move{};
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.milliseconds);
+
+    if (backend == SearchBackend::COPY_MAKE)
+    {
+        CopyMakeBackend stack(root);
+        return iterate(stack);
+    }
+
+    MakeUnmakeBackend board(root);
+    return iterate(board);
+}
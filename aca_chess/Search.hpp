@@ -0,0 +1,94 @@
+//
+//  Search.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Search_hpp
+#define Search_hpp
+
+#include "Board.hpp"
+#include "MovePicker.hpp"
+#include "Position.hpp"
+#include "TranspositionTable.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+struct SearchLimits
+{
+    int depth = 4;
+    uint64_t nodes = 0;         // 0 means unlimited
+    int milliseconds = 0;       // 0 means unlimited
+};
+
+struct SearchResult
+{
+    Move best{};
+    bool hasMove = false;
+    int score = 0;              // centipawns from the side to move, mates near +-MATE
+    int depth = 0;              // last completed iteration
+    uint64_t nodes = 0;
+
+    // Moves searched and beta cutoffs, indexed by the PickStage that produced them
+    uint64_t stageMoves[PICK_STAGES] = {};
+    uint64_t stageCutoffs[PICK_STAGES] = {};
+};
+
+// MAKE_UNMAKE plays and takes back moves on one Board, COPY_MAKE writes each
+// child to the next slot of a stack of cache-line Positions and never undoes.
+// Both search the same tree; build with ACA_SEARCH_COPYMAKE to default to
+// copy-make.
+enum class SearchBackend
+{
+    MAKE_UNMAKE,
+    COPY_MAKE
+};
+
+#ifdef ACA_SEARCH_COPYMAKE
+constexpr SearchBackend DEFAULT_SEARCH_BACKEND = SearchBackend::COPY_MAKE;
+#else
+constexpr SearchBackend DEFAULT_SEARCH_BACKEND = SearchBackend::MAKE_UNMAKE;
+#endif
+
+// Iterative deepening alpha-beta search for the side to move on a private copy
+// of the root position. One instance per thread. A search neither allocates
+// nor throws; debug builds check the invariants and the incremental key of
+// every node it visits, quiescence nodes included.
+class Search
+{
+    uint64_t nodes = 0;
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point deadline;
+    bool stopped = false;
+    TranspositionTable* table = nullptr;
+    uint64_t stageMoves[PICK_STAGES];
+    uint64_t stageCutoffs[PICK_STAGES];
+
+    bool shouldStop() noexcept;
+    template <typename Backend>
+    int quiesce(Backend& backend, int alpha, int beta, int ply) noexcept;
+    template <typename Backend>
+    int negamax(Backend& backend, int depth, int alpha, int beta, int ply, Move* best) noexcept;
+    template <typename Backend>
+    SearchResult iterate(Backend& backend) noexcept;
+public:
+    static constexpr int MATE = 100000;
+    static constexpr int INFINITE = 1000000;
+    static constexpr int MAX_PLY = 128;
+private:
+    // Two quiet moves per ply that last caused a beta cutoff
+    Move killers[MAX_PLY][2];
+public:
+    static int evaluate(const Board& board) noexcept;
+    static int evaluate(const Position& position) noexcept;
+
+    // Results are looked up in and stored to table, which must outlive the
+    // searches; null searches without one
+    void setTable(TranspositionTable* transpositions) noexcept { table = transpositions; }
+
+    SearchResult run(const Board& root, const SearchLimits& limits, SearchBackend backend = DEFAULT_SEARCH_BACKEND) noexcept;
+};
+
+#endif /* Search_hpp */
@@ -0,0 +1,568 @@
+//
+//  SessionServer.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "SessionServer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    const char* requestNames[] = {"new", "move", "legal", "status", "search", "close", "stats", "position"};
+
+    void setNonBlocking(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    bool isNumber(const char* text)
+    {
+        if (!*text)
+            return false;
+        for (; *text; text++)
+            if (*text < '0' || *text > '9')
+                return false;
+        return true;
+    }
+
+    const char* statusName(GameStatus status)
+    {
+        switch (status)
+        {
+            case GameStatus::CHECK:     return "check";
+            case GameStatus::CHECKMATE: return "checkmate";
+            case GameStatus::STALEMATE: return "stalemate";
+            default:                    return "playing";
+        }
+    }
+}
+
+SessionPool::~SessionPool()
+{
+    for (size_t b = 0; b < blocks.size(); b++)
+        for (uint32_t i = 0; i < BLOCK_SIZE; i++)
+            if (blocks[b][i].live)
+                reinterpret_cast<Game*>(blocks[b][i].storage)->~Game();
+}
+
+bool SessionPool::create(uint32_t& id)
+{
+    if (freeSlots.empty())
+    {
+        if (blocks.size() * BLOCK_SIZE >= MAX_SLOTS)
+            return false;
+
+        uint32_t base = static_cast<uint32_t>(blocks.size() * BLOCK_SIZE);
+        blocks.emplace_back(new Slot[BLOCK_SIZE]);
+        for (uint32_t i = BLOCK_SIZE; i > 0; i--)
+            freeSlots.push_back(base + i - 1);
+    }
+
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+
+    Slot& s = slot(index);
+    new (s.storage) Game();
+    s.live = true;
+    liveCount++;
+
+    id = (s.generation << SLOT_BITS) | index;
+    return true;
+}
+
+Game* SessionPool::find(uint32_t id)
+{
+    uint32_t index = id & ((1u << SLOT_BITS) - 1);
+    if (index >= blocks.size() * BLOCK_SIZE)
+        return nullptr;
+
+    Slot& s = slot(index);
+    if (!s.live || s.generation != id >> SLOT_BITS)
+        return nullptr;
+
+    return reinterpret_cast<Game*>(s.storage);
+}
+
+bool SessionPool::destroy(uint32_t id)
+{
+    Game* game = find(id);
+    if (!game)
+        return false;
+
+    uint32_t index = id & ((1u << SLOT_BITS) - 1);
+    Slot& s = slot(index);
+    game->~Game();
+    s.live = false;
+    s.generation = (s.generation + 1) & ((1u << (32 - SLOT_BITS)) - 1);
+    freeSlots.push_back(index);
+    liveCount--;
+
+    return true;
+}
+
+size_t SessionPool::heapBytes() const
+{
+    size_t bytes = 0;
+    for (uint32_t index = 0; index < blocks.size() * BLOCK_SIZE; index++)
+        if (slot(index).live)
+            bytes += reinterpret_cast<const Game*>(slot(index).storage)->heapBytes();
+    return bytes;
+}
+
+void LatencyRecorder::record(RequestType type, std::chrono::steady_clock::time_point received)
+{
+    auto elapsed = std::chrono::steady_clock::now() - received;
+    uint32_t micros = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+
+    // Keep a window of the most recent samples per type
+    auto& window = samples[(int)type];
+    uint64_t n = totals[(int)type]++;
+    if (window.size() < MAX_SAMPLES)
+        window.push_back(micros);
+    else
+        window[n % MAX_SAMPLES] = micros;
+}
+
+std::string LatencyRecorder::report() const
+{
+    std::ostringstream out;
+
+    for (int t = 0; t < (int)RequestType::COUNT; t++)
+    {
+        if (samples[t].empty())
+            continue;
+
+        std::vector<uint32_t> sorted = samples[t];
+        std::sort(sorted.begin(), sorted.end());
+        auto at = [&](double q) { return sorted[static_cast<size_t>(q * (sorted.size() - 1))]; };
+
+        out << "latency " << requestNames[t] << " n=" << totals[t] << " p50=" << at(0.5) << "us p90=" << at(0.9)
+            << "us p99=" << at(0.99) << "us max=" << sorted.back() << "us\n";
+    }
+
+    return out.str();
+}
+
+SessionServer::SessionServer(int workerCount, bool allowShutdown) : allowShutdown(allowShutdown)
+{
+    for (int i = 0; i < std::max(workerCount, 1); i++)
+        workers.emplace_back(&SessionServer::workerLoop, this);
+}
+
+SessionServer::~SessionServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shuttingDown = true;
+    }
+    jobReady.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto& [id, client] : clients)
+        close(client.fd);
+    if (listenFd >= 0)
+        close(listenFd);
+    if (!unixPath.empty())
+        unlink(unixPath.c_str());
+    if (wakePipe[0] >= 0)
+    {
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+    }
+}
+
+bool SessionServer::listen(const char* address)
+{
+    // A client hanging up must not take the whole server down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    if (pipe(wakePipe) != 0)
+        return false;
+    setNonBlocking(wakePipe[0]);
+    setNonBlocking(wakePipe[1]);
+
+    if (isNumber(address))
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::atoi(address)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+            return false;
+    }
+    else
+    {
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (std::strlen(address) >= sizeof(addr.sun_path))
+            return false;
+        std::strcpy(addr.sun_path, address);
+
+        unlink(address);
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+            return false;
+        unixPath = address;
+    }
+
+    setNonBlocking(listenFd);
+    return ::listen(listenFd, 128) == 0;
+}
+
+void SessionServer::workerLoop()
+{
+    Search search;
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&] { return shuttingDown || !jobs.empty(); });
+            if (shuttingDown)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        SearchResult result = search.run(job.board, job.limits);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completions.push_back({job.client, job.session, result, job.received});
+        }
+
+        char byte = 1;
+        (void)!write(wakePipe[1], &byte, 1);
+    }
+}
+
+void SessionServer::acceptClients()
+{
+    while (true)
+    {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        setNonBlocking(fd);
+        clients[nextClient++] = {fd, {}, {}};
+    }
+}
+
+void SessionServer::readClient(uint32_t id, Client& client)
+{
+    char buffer[4096];
+    Clock::time_point received = Clock::now();
+
+    while (client.fd >= 0)
+    {
+        ssize_t n = read(client.fd, buffer, sizeof(buffer));
+        if (n <= 0)
+        {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            {
+                close(client.fd);
+                client.fd = -1;
+            }
+            break;
+        }
+
+        // Lines are handled as each chunk arrives, so only a partial line stays buffered
+        client.input.append(buffer, static_cast<size_t>(n));
+
+        size_t start = 0, newline = std::string::npos;
+        while (client.fd >= 0 && (newline = client.input.find('\n', start)) != std::string::npos &&
+               newline - start <= MAX_LINE)
+        {
+            std::string line = client.input.substr(start, newline - start);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            start = newline + 1;
+            handleLine(id, client, line, received);
+        }
+        client.input.erase(0, start);
+
+        if (client.fd >= 0 && (newline != std::string::npos || client.input.size() > MAX_LINE))
+        {
+            close(client.fd);
+            client.fd = -1;
+        }
+    }
+}
+
+void SessionServer::writeClient(Client& client)
+{
+    while (!client.output.empty() && client.fd >= 0)
+    {
+        ssize_t n = write(client.fd, client.output.data(), client.output.size());
+        if (n <= 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                close(client.fd);
+                client.fd = -1;
+            }
+            return;
+        }
+        client.output.erase(0, static_cast<size_t>(n));
+    }
+}
+
+void SessionServer::handleLine(uint32_t clientId, Client& client, const std::string& line, Clock::time_point received)
+{
+    std::istringstream in(line);
+    std::string command, moveText;
+    uint32_t id = 0;
+    in >> command;
+
+    std::ostringstream out;
+
+    if (command == "new")
+    {
+        uint32_t session;
+        if (sessions.create(session))
+            out << "session " << session << "\n";
+        else
+            out << "error session limit reached\n";
+        latency.record(RequestType::NEW, received);
+    }
+    else if (command == "move" || command == "legal")
+    {
+        in >> id >> moveText;
+        Game* game = sessions.find(id);
+        Move move;
+        bool legal = game && game->getBoard().parseMove(moveText.c_str(), move);
+
+        if (command == "move")
+        {
+            out << (legal && game->play(move) ? "ok " : "illegal ") << id << "\n";
+            latency.record(RequestType::MOVE, received);
+        }
+        else
+        {
+            out << (legal ? "yes " : "no ") << id << "\n";
+            latency.record(RequestType::LEGAL, received);
+        }
+    }
+    else if (command == "status")
+    {
+        in >> id;
+        Game* game = sessions.find(id);
+        if (game)
+            out << "status " << id << " " << statusName(game->getBoard().status()) << "\n";
+        else
+            out << "error unknown session " << id << "\n";
+        latency.record(RequestType::STATUS, received);
+    }
+    else if (command == "position")
+    {
+        std::string fen;
+        in >> id;
+        std::getline(in >> std::ws, fen);
+
+        // Client positions are validated before a game ever holds them
+        Game* game = sessions.find(id);
+        Board board;
+        if (!game)
+        {
+            out << "error unknown session " << id << "\n";
+        }
+        else if (!board.setFen(fen))
+        {
+            out << "error illegal position " << id << "\n";
+        }
+        else
+        {
+            game->start(board);
+            out << "ok " << id << "\n";
+        }
+        latency.record(RequestType::POSITION, received);
+    }
+    else if (command == "search")
+    {
+        SearchLimits limits;
+        in >> id >> limits.depth;
+        in >> limits.milliseconds;
+
+        // Limits come from the client, a worker is never tied up for longer
+        limits.depth = std::clamp(limits.depth, 1, Search::MAX_PLY);
+        if (limits.milliseconds <= 0 || limits.milliseconds > MAX_SEARCH_MS)
+            limits.milliseconds = MAX_SEARCH_MS;
+
+        Game* game = sessions.find(id);
+        if (!game)
+        {
+            out << "error unknown session " << id << "\n";
+        }
+        else if (client.jobs >= MAX_CLIENT_JOBS)
+        {
+            out << "error too many searches " << id << "\n";
+        }
+        else
+        {
+            // The worker searches a copy, the session may keep changing meanwhile
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back({clientId, id, game->getBoard(), limits, received});
+            }
+            client.jobs++;
+            jobReady.notify_one();
+        }
+    }
+    else if (command == "close")
+    {
+        in >> id;
+        out << (sessions.destroy(id) ? "closed " : "error unknown session ") << id << "\n";
+        latency.record(RequestType::CLOSE, received);
+    }
+    else if (command == "stats")
+    {
+        size_t live = sessions.liveSessions();
+        size_t heap = sessions.heapBytes();
+        out << latency.report();
+        out << "sessions " << live << " bytes/session " << SessionPool::slotBytes() + (live ? heap / live : 0)
+            << " (slot " << SessionPool::slotBytes() << ") reserved " << sessions.reservedBytes()
+            << " heap " << heap << "\n";
+        latency.record(RequestType::STATS, received);
+    }
+    else if (command == "shutdown")
+    {
+        if (allowShutdown)
+            running = false;
+        else
+            out << "error shutdown not allowed\n";
+    }
+    else if (!command.empty())
+    {
+        out << "error unknown command " << command << "\n";
+    }
+
+    client.output += out.str();
+    if (client.output.size() > MAX_OUTPUT)
+    {
+        close(client.fd);
+        client.fd = -1;
+    }
+}
+
+void SessionServer::dropClient(uint32_t id)
+{
+    // Searches the client queued but no worker took yet are not run
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [id](const Job& job) { return job.client == id; }),
+               jobs.end());
+}
+
+void SessionServer::drainCompletions()
+{
+    char buffer[256];
+    while (read(wakePipe[0], buffer, sizeof(buffer)) > 0)
+        ;
+
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(completions);
+    }
+
+    for (const Completion& c : done)
+    {
+        latency.record(RequestType::SEARCH, c.received);
+
+        auto it = clients.find(c.client);
+        if (it == clients.end() || it->second.fd < 0)
+            continue;
+
+        Client& client = it->second;
+        client.jobs--;
+
+        std::ostringstream out;
+        out << "bestmove " << c.session << " " << (c.result.hasMove ? c.result.best.toString() : "none")
+            << " " << c.result.score << " " << c.result.nodes << "\n";
+        client.output += out.str();
+        if (client.output.size() > MAX_OUTPUT)
+        {
+            close(client.fd);
+            client.fd = -1;
+        }
+    }
+}
+
+void SessionServer::run()
+{
+    running = true;
+    std::vector<pollfd> fds;
+    std::vector<uint32_t> ids;
+
+    while (running)
+    {
+        fds.clear();
+        ids.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakePipe[0], POLLIN, 0});
+
+        for (auto& [id, client] : clients)
+        {
+            short events = POLLIN;
+            if (!client.output.empty())
+                events |= POLLOUT;
+            fds.push_back({client.fd, events, 0});
+            ids.push_back(id);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+            break;
+
+        if (fds[1].revents & POLLIN)
+            drainCompletions();
+
+        for (size_t i = 2; i < fds.size(); i++)
+        {
+            Client& client = clients[ids[i - 2]];
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                readClient(ids[i - 2], client);
+        }
+
+        if (fds[0].revents & POLLIN)
+            acceptClients();
+
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            writeClient(it->second);
+            if (it->second.fd < 0)
+            {
+                dropClient(it->first);
+                it = clients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+//
+//  SessionServer.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef SessionServer_hpp
+#define SessionServer_hpp
+
+#include "Game.hpp"
+#include "Search.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Games live in fixed-size slots carved out of blocks of BLOCK_SIZE, freed
+// slots are reused first. Session ids carry a generation so a stale id never
+// reaches the game that took over its slot. The slot index takes the low
+// SLOT_BITS of an id, which caps the pool at MAX_SLOTS games.
+class SessionPool
+{
+    struct Slot
+    {
+        alignas(Game) unsigned char storage[sizeof(Game)];
+        uint32_t generation = 0;
+        bool live = false;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    std::vector<uint32_t> freeSlots;
+    size_t liveCount = 0;
+
+    Slot& slot(uint32_t index) { return blocks[index / BLOCK_SIZE][index % BLOCK_SIZE]; }
+    const Slot& slot(uint32_t index) const { return blocks[index / BLOCK_SIZE][index % BLOCK_SIZE]; }
+public:
+    static constexpr uint32_t BLOCK_SIZE = 1024;
+    static constexpr int SLOT_BITS = 20;
+    static constexpr uint32_t MAX_SLOTS = 1u << SLOT_BITS;
+
+    SessionPool() = default;
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+    ~SessionPool();
+
+    // Fails once MAX_SLOTS games are live
+    bool create(uint32_t& id);
+    Game* find(uint32_t id);
+    bool destroy(uint32_t id);
+
+    size_t liveSessions() const { return liveCount; }
+    size_t reservedBytes() const { return blocks.size() * BLOCK_SIZE * sizeof(Slot); }
+    static size_t slotBytes() { return sizeof(Slot); }
+    // What the live games hold outside their slots, walks every slot
+    size_t heapBytes() const;
+};
+
+enum class RequestType
+{
+    NEW,
+    MOVE,
+    LEGAL,
+    STATUS,
+    SEARCH,
+    CLOSE,
+    STATS,
+    POSITION,
+    COUNT
+};
+
+class LatencyRecorder
+{
+    static constexpr size_t MAX_SAMPLES = 1 << 16;
+
+    std::vector<uint32_t> samples[(int)RequestType::COUNT];
+    uint64_t totals[(int)RequestType::COUNT] = {};
+public:
+    void record(RequestType type, std::chrono::steady_clock::time_point received);
+    std::string report() const;
+};
+
+// Hosts many Game sessions in one process over a line protocol on a Unix
+// socket or a loopback TCP port. One thread runs a poll() loop and answers
+// cheap requests inline; searches go to a worker pool and their results are
+// handed back to the loop through a pipe.
+//
+//   new                       -> session <id>
+//   move <id> <e2e4>          -> ok <id> | illegal <id>
+//   legal <id> <e2e4>         -> yes <id> | no <id>
+//   status <id>               -> status <id> playing|check|checkmate|stalemate
+//   position <id> <fen>       -> ok <id> | error illegal position <id>
+//   search <id> <depth> [ms]  -> bestmove <id> <move> <score> <nodes>
+//   close <id>                -> closed <id>
+//   stats                     -> latency percentiles and memory per session
+//   shutdown                  (only when the server was started to allow it)
+//
+// Searches run to at most Search::MAX_PLY plies and MAX_SEARCH_MS, a client
+// may have MAX_CLIENT_JOBS of them queued or running. Lines longer than
+// MAX_LINE bytes, or more than MAX_OUTPUT bytes of replies the client does
+// not read, get the client disconnected.
+class SessionServer
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t MAX_LINE = 1024;
+    static constexpr size_t MAX_OUTPUT = 1 << 20;
+    static constexpr size_t MAX_CLIENT_JOBS = 16;
+    static constexpr int MAX_SEARCH_MS = 60000;
+
+    struct Client
+    {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t jobs = 0;
+    };
+
+    struct Job
+    {
+        uint32_t client;
+        uint32_t session;
+        Board board;
+        SearchLimits limits;
+        Clock::time_point received;
+    };
+
+    struct Completion
+    {
+        uint32_t client;
+        uint32_t session;
+        SearchResult result;
+        Clock::time_point received;
+    };
+
+    int listenFd = -1;
+    int wakePipe[2] = {-1, -1};
+    std::string unixPath;
+    bool running = false;
+    bool allowShutdown;
+
+    std::unordered_map<uint32_t, Client> clients;
+    uint32_t nextClient = 1;
+
+    SessionPool sessions;
+    LatencyRecorder latency;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::deque<Job> jobs;
+    std::vector<Completion> completions;
+    bool shuttingDown = false;
+
+    void workerLoop();
+    void acceptClients();
+    void readClient(uint32_t id, Client& client);
+    void writeClient(Client& client);
+    void handleLine(uint32_t clientId, Client& client, const std::string& line, Clock::time_point received);
+    void drainCompletions();
+    void dropClient(uint32_t id);
+public:
+    // The shutdown request is ignored unless allowShutdown is set
+    explicit SessionServer(int workerCount, bool allowShutdown = false);
+    ~SessionServer();
+
+    // A number listens on that loopback TCP port, anything else is a socket path
+    bool listen(const char* address);
+    void run();
+};
+
+#endif /* SessionServer_hpp */
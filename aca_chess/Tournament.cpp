@@ -0,0 +1,218 @@
+//
+//  Tournament.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "Tournament.hpp"
+#include "Game.hpp"
+#include "Zobrist.hpp"
+#include "Attacks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    double expectedScore(double elo)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    double scoreToElo(double score)
+    {
+        score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    bool insufficientMaterial(const Board& board)
+    {
+        uint64_t heavy = board.getBitboard(Piece::WHITEPAWN) | board.getBitboard(Piece::BLACKPAWN) |
+                         board.getBitboard(Piece::WHITEROOK) | board.getBitboard(Piece::BLACKROOK) |
+                         board.getBitboard(Piece::WHITEQUEEN) | board.getBitboard(Piece::BLACKQUEEN);
+        uint64_t minors = board.getBitboard(Piece::WHITEBISHOP) | board.getBitboard(Piece::BLACKBISHOP) |
+                          board.getBitboard(Piece::WHITEKNIGHT) | board.getBitboard(Piece::BLACKKNIGHT);
+
+        return !heavy && __builtin_popcountll(minors) <= 1;
+    }
+}
+
+double TournamentScore::elo(double* margin) const
+{
+    int n = games();
+    if (n == 0)
+    {
+        if (margin)
+            *margin = 0;
+        return 0;
+    }
+
+    double w = double(wins) / n, d = double(draws) / n, l = double(losses) / n;
+    double score = w + d / 2;
+    double variance = w * std::pow(1 - score, 2) + d * std::pow(0.5 - score, 2) + l * std::pow(score, 2);
+
+    // 95% confidence interval of the mean score, mapped to Elo
+    if (margin)
+    {
+        double deviation = 1.96 * std::sqrt(variance / n);
+        *margin = (scoreToElo(score + deviation) - scoreToElo(score - deviation)) / 2;
+    }
+
+    return scoreToElo(score);
+}
+
+double TournamentScore::llr(double elo0, double elo1) const
+{
+    int n = games();
+    if (n == 0 || wins + losses == 0)
+        return 0;
+
+    double w = double(wins) / n, d = double(draws) / n, l = double(losses) / n;
+    double score = w + d / 2;
+    double variance = w * std::pow(1 - score, 2) + d * std::pow(0.5 - score, 2) + l * std::pow(score, 2);
+    if (variance <= 0)
+        return 0;
+
+    // Normal approximation of the trinomial GSPRT
+    double s0 = expectedScore(elo0), s1 = expectedScore(elo1);
+    return n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance);
+}
+
+Tournament::Tournament(const TournamentOptions& options) : options(options)
+{
+}
+
+bool Tournament::loadOpenings(const char* epdPath)
+{
+    std::ifstream in(epdPath);
+    if (!in)
+        return false;
+
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++)
+    {
+        Board board;
+        if (line.empty())
+            continue;
+        if (board.setFen(line))
+            openings.push_back(board);
+        else
+            std::cerr << "Skipping opening on line " << number << ", not a legal position: " << line << std::endl;
+    }
+
+    return !openings.empty();
+}
+
+int Tournament::playGame(const Board& opening, int whiteEngine) const
+{
+    Game game;
+    game.start(opening);
+    Search searches[2];
+
+    std::vector<uint64_t> history{Zobrist::polyglotKey(opening)};
+    int halfmoves = 0;
+
+    for (int ply = 0; ply < options.maxPlies; ply++)
+    {
+        const Board& board = game.getBoard();
+        GameStatus status = board.status();
+
+        if (status == GameStatus::CHECKMATE)
+        {
+            // The side to move is mated
+            int loser = board.isWhiteToMove() ? whiteEngine : 1 - whiteEngine;
+            return loser == 0 ? -1 : 1;
+        }
+        if (status == GameStatus::STALEMATE || halfmoves >= 100 || insufficientMaterial(board))
+            return 0;
+
+        int repetitions = 0;
+        for (size_t i = history.size() - 1 - std::min<size_t>(halfmoves, history.size() - 1); i < history.size(); i++)
+            repetitions += history[i] == history.back();
+        if (repetitions >= 3)
+            return 0;
+
+        int engine = board.isWhiteToMove() ? whiteEngine : 1 - whiteEngine;
+        SearchResult result = searches[engine].run(board, options.engines[engine].limits);
+        if (!result.hasMove)
+            return 0;
+
+        Piece moved = board.get(Attacks::row(result.best.from), Attacks::col(result.best.from));
+        bool irreversible = (result.best.flags & MOVE_CAPTURE) || moved == Piece::WHITEPAWN || moved == Piece::BLACKPAWN;
+
+        game.play(result.best);
+        halfmoves = irreversible ? 0 : halfmoves + 1;
+        history.push_back(Zobrist::polyglotKey(game.getBoard()));
+    }
+
+    return 0;
+}
+
+TournamentScore Tournament::run()
+{
+    TournamentScore score;
+    if (openings.empty())
+        openings.push_back(Board());
+
+    double lower = std::log(options.beta / (1 - options.alpha));
+    double upper = std::log((1 - options.beta) / options.alpha);
+
+    std::atomic<int> nextGame{0};
+    std::atomic<bool> decided{false};
+    std::mutex mutex;
+
+    auto worker = [&]() {
+        while (!decided)
+        {
+            int index = nextGame++;
+            if (index >= options.games)
+                return;
+
+            // Each opening is played from both sides
+            const Board& opening = openings[(index / 2) % openings.size()];
+            int result = playGame(opening, index % 2);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decided)
+                return;
+
+            if (result > 0)
+                score.wins++;
+            else if (result < 0)
+                score.losses++;
+            else
+                score.draws++;
+
+            double margin;
+            double elo = score.elo(&margin);
+            double llr = score.llr(options.elo0, options.elo1);
+
+            std::cout << std::fixed << std::setprecision(2) << "games " << score.games() << "  +" << score.wins
+                      << " =" << score.draws << " -" << score.losses << "  elo " << elo << " +- " << margin
+                      << "  llr " << llr << " [" << lower << ", " << upper << "]" << std::endl;
+
+            if (llr >= upper || llr <= lower)
+            {
+                decided = true;
+                std::cout << "SPRT: " << (llr >= upper ? "H1 accepted, " : "H0 accepted, ")
+                          << options.engines[0].name << (llr >= upper ? " is stronger" : " is not stronger")
+                          << " than " << options.engines[1].name << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::max(options.threads, 1); t++)
+        threads.emplace_back(worker);
+    for (auto& thread : threads)
+        thread.join();
+
+    return score;
+}
@@ -0,0 +1,64 @@
+//
+//  Tournament.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Tournament_hpp
+#define Tournament_hpp
+
+#include "Board.hpp"
+#include "Search.hpp"
+
+#include <string>
+#include <vector>
+
+struct EngineConfig
+{
+    std::string name;
+    SearchLimits limits;
+};
+
+struct TournamentOptions
+{
+    EngineConfig engines[2];
+    int games = 1000;
+    int threads = 1;
+    int maxPlies = 400;         // longer games are adjudicated as draws
+
+    // SPRT between H0: elo = elo0 and H1: elo = elo1 for engine 0
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+};
+
+struct TournamentScore
+{
+    int wins = 0;       // from the point of view of engine 0
+    int draws = 0;
+    int losses = 0;
+
+    int games() const { return wins + draws + losses; }
+    double elo(double* margin = nullptr) const;
+    double llr(double elo0, double elo1) const;
+};
+
+// Plays engine-vs-engine games in-process, one per thread. Every opening is
+// played twice with colours reversed; results, Elo and the SPRT log-likelihood
+// ratio are printed after each game and the run stops once the SPRT decides.
+class Tournament
+{
+    TournamentOptions options;
+    std::vector<Board> openings;
+
+    int playGame(const Board& opening, int whiteEngine) const;
+public:
+    explicit Tournament(const TournamentOptions& options);
+
+    bool loadOpenings(const char* epdPath);
+    TournamentScore run();
+};
+
+#endif /* Tournament_hpp */
@@ -0,0 +1,426 @@
+//
+//  TranspositionTable.cpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#include "TranspositionTable.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char MAGIC[4] = {'A', 'C', 'T', 'T'};
+    constexpr size_t HEADER_SIZE = 24;
+    constexpr size_t ENTRY_SIZE = 16;
+
+    void putLittleEndian(uint8_t* p, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    uint64_t getLittleEndian(const uint8_t* p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--)
+            value = (value << 8) | p[i];
+        return value;
+    }
+
+    TableEntry readEntry(const uint8_t* bytes)
+    {
+        TableEntry entry;
+        entry.key = getLittleEndian(bytes, 8);
+        entry.move = static_cast<uint16_t>(getLittleEndian(bytes + 8, 2));
+        entry.score = static_cast<int32_t>(static_cast<uint32_t>(getLittleEndian(bytes + 10, 4)));
+        entry.depth = bytes[14];
+        entry.bound = static_cast<Bound>(bytes[15]);
+        return entry;
+    }
+
+    void writeEntry(std::ofstream& out, const TableEntry& entry)
+    {
+        uint8_t bytes[ENTRY_SIZE];
+        putLittleEndian(bytes, entry.key, 8);
+        putLittleEndian(bytes + 8, entry.move, 2);
+        putLittleEndian(bytes + 10, static_cast<uint32_t>(entry.score), 4);
+        bytes[14] = entry.depth;
+        bytes[15] = static_cast<uint8_t>(entry.bound);
+        out.write(reinterpret_cast<const char*>(bytes), ENTRY_SIZE);
+    }
+
+    // Identifies the key table, whose keys a snapshot is only valid under
+    uint64_t keyFingerprint()
+    {
+        return Zobrist::polyglotKey(Board());
+    }
+
+    // Returns the entry count, or -1 if the file is not a snapshot of this
+    // version made with the current key table
+    int64_t checkHeader(const MappedFile& file)
+    {
+        if (!file.isOpen() || file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0)
+            return -1;
+        if (getLittleEndian(file.data() + 4, 4) != TranspositionTable::FORMAT_VERSION)
+            return -1;
+        if (getLittleEndian(file.data() + 16, 8) != keyFingerprint())
+            return -1;
+
+        // The count comes from the file, so it is compared without multiplying it
+        uint64_t count = getLittleEndian(file.data() + 8, 8);
+        if ((file.size() - HEADER_SIZE) % ENTRY_SIZE != 0 || count != (file.size() - HEADER_SIZE) / ENTRY_SIZE)
+            return -1;
+
+        return static_cast<int64_t>(count);
+    }
+
+    // Deeper results win, exact scores win ties
+    bool better(const TableEntry& a, const TableEntry& b)
+    {
+        if (a.depth != b.depth)
+            return a.depth > b.depth;
+        return a.bound == Bound::EXACT && b.bound != Bound::EXACT;
+    }
+
+    // Entry data packed into one word: move, score, depth and bound
+    uint64_t packData(const TableEntry& entry)
+    {
+        return entry.move | static_cast<uint64_t>(static_cast<uint32_t>(entry.score)) << 16 |
+               static_cast<uint64_t>(entry.depth) << 48 | static_cast<uint64_t>(entry.bound) << 56;
+    }
+
+    TableEntry unpackData(uint64_t key, uint64_t data)
+    {
+        TableEntry entry;
+        entry.key = key;
+        entry.move = static_cast<uint16_t>(data);
+        entry.score = static_cast<int32_t>(static_cast<uint32_t>(data >> 16));
+        entry.depth = static_cast<uint8_t>(data >> 48);
+        entry.bound = static_cast<Bound>(data >> 56);
+        return entry;
+    }
+
+    // A sorted run of entries, either in memory or in a mapped snapshot
+    struct Source
+    {
+        const TableEntry* entries = nullptr;
+        const uint8_t* bytes = nullptr;
+        uint64_t count = 0;
+        uint64_t next = 0;
+
+        TableEntry at(uint64_t index) const
+        {
+            return entries ? entries[index] : readEntry(bytes + index * ENTRY_SIZE);
+        }
+    };
+
+    // Writes the union of the sources to path through a temporary file, so a
+    // snapshot that is mapped while being rewritten stays intact
+    bool writeMerged(std::vector<Source>& sources, const char* path, uint64_t* written)
+    {
+        std::string temporary = std::string(path) + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+            return false;
+
+        uint8_t header[HEADER_SIZE] = {};
+        out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+
+        uint64_t count = 0;
+        while (true)
+        {
+            bool found = false;
+            TableEntry best;
+            for (const Source& source : sources)
+            {
+                if (source.next == source.count)
+                    continue;
+
+                TableEntry entry = source.at(source.next);
+                if (!found || entry.key < best.key || (entry.key == best.key && better(entry, best)))
+                    best = entry;
+                found = true;
+            }
+
+            if (!found)
+                break;
+
+            for (Source& source : sources)
+                while (source.next < source.count && source.at(source.next).key == best.key)
+                    source.next++;
+
+            writeEntry(out, best);
+            count++;
+        }
+
+        std::memcpy(header, MAGIC, sizeof(MAGIC));
+        putLittleEndian(header + 4, TranspositionTable::FORMAT_VERSION, 4);
+        putLittleEndian(header + 8, count, 8);
+        putLittleEndian(header + 16, keyFingerprint(), 8);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+        out.close();
+
+        if (!out || std::rename(temporary.c_str(), path) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        if (written)
+            *written = count;
+        return true;
+    }
+}
+
+TranspositionTable::TranspositionTable(size_t entries)
+{
+    size_t size = 1;
+    while (size * 2 <= entries)
+        size *= 2;
+
+    memory.assign(size * 2, 0);
+    words = memory.data();
+    slotCount = size;
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    detach();
+}
+
+void TranspositionTable::detach()
+{
+    if (sharedBytes)
+        munmap(words, sharedBytes);
+    sharedBytes = 0;
+    words = memory.data();
+    slotCount = memory.size() / 2;
+}
+
+bool TranspositionTable::attachShared(const char* name, size_t entries)
+{
+    size_t size = 1;
+    while (size * 2 <= entries)
+        size *= 2;
+
+    // Exactly one process creates and sizes the segment. The others open it as
+    // it is, never resizing it, and wait until its creator has published the
+    // size; ftruncate makes it visible in one step
+    struct stat st;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+        if (ftruncate(fd, static_cast<off_t>(size * 16)) != 0)
+        {
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+    }
+    else if (errno == EEXIST)
+    {
+        fd = shm_open(name, O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+
+        // A creator that died before sizing leaves an empty segment behind,
+        // which has to be removed with removeShared
+        for (int attempt = 0; fstat(fd, &st) == 0 && st.st_size == 0 && attempt < 1000; attempt++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    else
+    {
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < 16)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size = 1;
+    while (size * 2 * 16 <= static_cast<size_t>(st.st_size))
+        size *= 2;
+
+    void* p = mmap(nullptr, size * 16, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    detach();
+    words = static_cast<uint64_t*>(p);
+    slotCount = size;
+    sharedBytes = size * 16;
+
+    // The private table is no longer needed
+    std::vector<uint64_t>().swap(memory);
+    return true;
+}
+
+bool TranspositionTable::removeShared(const char* name)
+{
+    return shm_unlink(name) == 0;
+}
+
+bool TranspositionTable::readSlot(size_t index, TableEntry& entry) const noexcept
+{
+    uint64_t check = __atomic_load_n(&words[index * 2], __ATOMIC_RELAXED);
+    uint64_t data = __atomic_load_n(&words[index * 2 + 1], __ATOMIC_RELAXED);
+
+    entry = unpackData(check ^ data, data);
+    return entry.bound != Bound::NONE;
+}
+
+void TranspositionTable::writeSlot(size_t index, const TableEntry& entry) noexcept
+{
+    uint64_t data = packData(entry);
+    __atomic_store_n(&words[index * 2], entry.key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&words[index * 2 + 1], data, __ATOMIC_RELAXED);
+}
+
+bool TranspositionTable::findInSnapshot(uint64_t key, TableEntry& entry) const noexcept
+{
+    const uint8_t* entries = snapshot.data() + HEADER_SIZE;
+    uint64_t low = 0, high = snapshotCount;
+    while (low < high)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if (getLittleEndian(entries + middle * ENTRY_SIZE, 8) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == snapshotCount || getLittleEndian(entries + low * ENTRY_SIZE, 8) != key)
+        return false;
+
+    entry = readEntry(entries + low * ENTRY_SIZE);
+    return true;
+}
+
+bool TranspositionTable::probe(uint64_t key, TableEntry& entry) noexcept
+{
+    size_t index = key & (slotCount - 1);
+    TableEntry slot;
+    bool occupied = readSlot(index, slot);
+    if (occupied && slot.key == key)
+    {
+        entry = slot;
+        return true;
+    }
+
+    if (!snapshotCount || !findInSnapshot(key, entry))
+        return false;
+
+    // Later probes of this position stay in the table
+    if (!occupied || !better(slot, entry))
+        writeSlot(index, entry);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, uint16_t move, int score, int depth, Bound bound) noexcept
+{
+    size_t index = key & (slotCount - 1);
+    TableEntry slot;
+    bool occupied = readSlot(index, slot) && slot.key == key;
+    if (occupied && slot.depth > depth)
+        return;
+
+    TableEntry entry;
+    entry.key = key;
+    // Keep the best move of a shallower search if this one found none
+    entry.move = !move && occupied ? slot.move : move;
+    entry.score = score;
+    entry.depth = static_cast<uint8_t>(std::min(depth, 255));
+    entry.bound = bound;
+    writeSlot(index, entry);
+}
+
+void TranspositionTable::clear()
+{
+    for (size_t i = 0; i < slotCount * 2; i++)
+        __atomic_store_n(&words[i], 0, __ATOMIC_RELAXED);
+}
+
+bool TranspositionTable::load(const char* path)
+{
+    snapshot.close();
+    snapshotCount = 0;
+
+    if (!snapshot.open(path))
+        return false;
+
+    int64_t count = checkHeader(snapshot);
+    if (count < 0)
+    {
+        snapshot.close();
+        return false;
+    }
+
+    snapshotCount = static_cast<uint64_t>(count);
+    return true;
+}
+
+bool TranspositionTable::save(const char* path) const
+{
+    std::vector<TableEntry> entries;
+    TableEntry slot;
+    for (size_t i = 0; i < slotCount; i++)
+        if (readSlot(i, slot))
+            entries.push_back(slot);
+
+    std::sort(entries.begin(), entries.end(), [](const TableEntry& a, const TableEntry& b) {
+        return a.key < b.key;
+    });
+
+    std::vector<Source> sources(1);
+    sources[0].entries = entries.data();
+    sources[0].count = entries.size();
+
+    if (snapshotCount)
+    {
+        Source mapped;
+        mapped.bytes = snapshot.data() + HEADER_SIZE;
+        mapped.count = snapshotCount;
+        sources.push_back(mapped);
+    }
+
+    return writeMerged(sources, path, nullptr);
+}
+
+bool TranspositionTable::merge(const std::vector<std::string>& inputs, const char* output, uint64_t* written)
+{
+    std::vector<MappedFile> files(inputs.size());
+    std::vector<Source> sources;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        files[i].open(inputs[i].c_str());
+        int64_t count = checkHeader(files[i]);
+        if (count < 0)
+            return false;
+
+        Source source;
+        source.bytes = files[i].data() + HEADER_SIZE;
+        source.count = static_cast<uint64_t>(count);
+        sources.push_back(source);
+    }
+
+    return writeMerged(sources, output, written);
+}
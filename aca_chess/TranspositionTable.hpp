@@ -0,0 +1,97 @@
+//
+//  TranspositionTable.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef TranspositionTable_hpp
+#define TranspositionTable_hpp
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class Bound : uint8_t
+{
+    NONE,
+    UPPER,      // score is at most the stored value
+    LOWER,      // score is at least the stored value
+    EXACT
+};
+
+struct TableEntry
+{
+    uint64_t key = 0;
+    uint16_t move = 0;      // Move::pack(), 0 if none
+    int32_t score = 0;
+    uint8_t depth = 0;
+    Bound bound = Bound::NONE;
+};
+
+// Search results by Polyglot key. New results go to a table with one entry
+// per slot; a snapshot of earlier runs can be mapped read-only and is
+// consulted when the table misses.
+//
+// A slot is two 64-bit words, the packed entry data and the key XORed with
+// it. Readers recompute the key from both words, so a slot torn by a
+// concurrent writer simply reads as a miss. That lets threads, and processes
+// attached to the same POSIX shared-memory segment, share one table without
+// locks.
+//
+// A snapshot file is a 24-byte header ("ACTT", format version, entry count and
+// the start-position key as little-endian 32 and 64-bit words) followed by
+// 16-byte little-endian entries (key, move, score, depth, bound) sorted by key,
+// one per key. The start-position key identifies the Zobrist table, so a
+// snapshot written under other keys is rejected instead of matching the wrong
+// positions.
+class TranspositionTable
+{
+    std::vector<uint64_t> memory;
+    uint64_t* words = nullptr;      // memory, or the shared segment
+    size_t slotCount = 0;
+    size_t sharedBytes = 0;
+
+    MappedFile snapshot;
+    uint64_t snapshotCount = 0;
+
+    bool findInSnapshot(uint64_t key, TableEntry& entry) const noexcept;
+    bool readSlot(size_t index, TableEntry& entry) const noexcept;
+    void writeSlot(size_t index, const TableEntry& entry) noexcept;
+    void detach();
+public:
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    // entries is rounded down to a power of two
+    explicit TranspositionTable(size_t entries = 1 << 20);
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Replaces the private table by the shared-memory segment name ("/aca-tt"),
+    // creating it with the given number of entries if it does not exist yet;
+    // an existing segment keeps its size, whatever entries says
+    bool attachShared(const char* name, size_t entries);
+    static bool removeShared(const char* name);
+    bool isShared() const { return sharedBytes != 0; }
+
+    bool probe(uint64_t key, TableEntry& entry) noexcept;
+    void store(uint64_t key, uint16_t move, int score, int depth, Bound bound) noexcept;
+    void clear();
+
+    // Maps a snapshot, replacing the previous one
+    bool load(const char* path);
+    // Writes the table merged with the loaded snapshot
+    bool save(const char* path) const;
+
+    // Combines snapshot files, keeping the deepest result for every key.
+    // Returns false if an input is missing or has another format version or
+    // key table.
+    static bool merge(const std::vector<std::string>& inputs, const char* output, uint64_t* written = nullptr);
+};
+
+#endif /* TranspositionTable_hpp */
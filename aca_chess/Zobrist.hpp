@@ -0,0 +1,59 @@
+//
+//  Zobrist.hpp
+//  aca_chess
+//
+//  Created by Alex Aramyan on 19.10.26.
+//
+
+#ifndef Zobrist_hpp
+#define Zobrist_hpp
+
+#include "Board.hpp"
+#include "Position.hpp"
+
+#include <cstdint>
+
+// Position keys in the Polyglot layout: 768 piece-square keys, 4 castling keys,
+// 8 en-passant file keys and one side-to-move key.
+//
+// The built-in table is the standard Polyglot Random64 table, so keys match
+// books produced by other tools. loadPolyglotTable replaces it from a file of
+// 781 big-endian 64-bit words; a table is only accepted when it gives the start
+// position the published Polyglot key.
+namespace Zobrist
+{
+    constexpr int PIECE_KEYS = 768;
+    constexpr int CASTLE_OFFSET = 768;
+    constexpr int EN_PASSANT_OFFSET = 772;
+    constexpr int TURN_OFFSET = 780;
+    constexpr int KEY_COUNT = 781;
+
+    // Key of the start position under the standard Random64 table
+    constexpr uint64_t POLYGLOT_START_KEY = 0x463b96181691fc9cULL;
+
+    // Keeps the current table when path cannot be read or is not the standard one
+    bool loadPolyglotTable(const char* path);
+    bool hasStandardKeys() noexcept;
+
+    // square is the Board bit index (row * 8 + (7 - col))
+    uint64_t pieceKey(Piece piece, int square) noexcept;
+    uint64_t castlingKey(int index) noexcept;
+    uint64_t enPassantKey(int col) noexcept;
+    uint64_t turnKey() noexcept;
+
+    uint64_t polyglotKey(const Board& board) noexcept;
+    uint64_t polyglotKey(const Position& position) noexcept;
+
+    // The en-passant part of a key, 0 unless a pawn of the side to move can
+    // capture on the file
+    uint64_t enPassantTerm(const Board& board) noexcept;
+    uint64_t enPassantTerm(const Position& position) noexcept;
+
+    // Everything else a move changes in the key: the moved, captured and
+    // castling pieces, the castling rights in lostRights and the side to
+    // move. A key is updated as key ^ enPassantTerm(before) ^ moveKey(...) ^
+    // enPassantTerm(after); captured is Piece::NONE for en passant.
+    uint64_t moveKey(const Move& move, Piece moved, Piece captured, uint8_t lostRights) noexcept;
+}
+
+#endif /* Zobrist_hpp */
@@ -6,13 +6,412 @@
 //
 
 #include "Game.hpp"
+#include "Benchmark.hpp"
+#include "Fuzz.hpp"
+#include "PgnReader.hpp"
+#include "PositionIndex.hpp"
+#include "SessionServer.hpp"
+#include "Tournament.hpp"
+#include "TranspositionTable.hpp"
+#include "Zobrist.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+static int runReplay(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " replay <games.pgn> [threads]" << std::endl;
+        return 1;
+    }
+    
+    PgnReader reader;
+    if (!reader.open(argv[2]))
+    {
+        std::cerr << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    int threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+    ReplayStats stats = reader.replay(threads);
+    
+    std::cout << "games:   " << stats.games << " (" << stats.errors << " with illegal moves, "
+              << stats.skipped << " from custom positions)" << std::endl;
+    std::cout << "moves:   " << stats.moves << std::endl;
+    std::cout << "time:    " << stats.seconds << " s" << std::endl;
+    std::cout << "games/s: " << static_cast<uint64_t>(stats.games / stats.seconds) << std::endl;
+    std::cout << "moves/s: " << static_cast<uint64_t>(stats.moves / stats.seconds) << std::endl;
+    
+    return stats.errors == 0 ? 0 : 2;
+}
+
+static int runIndex(int argc, const char * argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " index <games.pgn> <positions.idx> [threads]" << std::endl;
+        return 1;
+    }
+    
+    int threads = argc > 4 ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+    PositionIndexBuilder builder(argv[3]);
+    uint64_t entries;
+    if (!builder.build(argv[2], threads, entries))
+    {
+        std::cerr << "Could not build " << argv[3] << " from " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << entries << " entries written to " << argv[3] << std::endl;
+    
+    return 0;
+}
+
+static int runQuery(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " query <positions.idx> [SAN moves...]" << std::endl;
+        return 1;
+    }
+    
+    PositionIndex index;
+    if (!index.open(argv[2]))
+    {
+        std::cerr << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    Board board;
+    for (int i = 3; i < argc; i++)
+    {
+        MoveList legal;
+        board.legalMoves(legal);
+        
+        Move move;
+        if (!PgnReader::matchSan(board, legal, argv[i], argv[i] + std::strlen(argv[i]), move))
+        {
+            std::cerr << "Illegal move " << argv[i] << std::endl;
+            return 1;
+        }
+        board.makeMove(move);
+    }
+    
+    IndexEntry entries[256];
+    int count = std::min(index.lookup(board, entries, 256), 256);
+    
+    for (int i = 0; i < count; i++)
+    {
+        Move move = board.unpackMove(entries[i].move);
+        std::cout << move.toString() << "  +" << entries[i].whiteWins << " =" << entries[i].draws
+                  << " -" << entries[i].blackWins << std::endl;
+    }
+    
+    return 0;
+}
+
+static int runServer(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " serve <port|socket path> [search threads] [--allow-shutdown]" << std::endl;
+        return 1;
+    }
+    
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool allowShutdown = false;
+    for (int i = 3; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--allow-shutdown") == 0)
+            allowShutdown = true;
+        else
+            threads = std::atoi(argv[i]);
+    }
+    
+    SessionServer server(threads, allowShutdown);
+    if (!server.listen(argv[2]))
+    {
+        std::cerr << "Could not listen on " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    server.run();
+    return 0;
+}
+
+static int runTournament(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " tournament <openings.epd> [games=N] [threads=N]"
+                  << " [depth0=N] [nodes0=N] [ms0=N] [depth1=N] [nodes1=N] [ms1=N]"
+                  << " [elo0=X] [elo1=X] [alpha=X] [beta=X]" << std::endl;
+        return 1;
+    }
+    
+    TournamentOptions options;
+    options.engines[0].name = "engine0";
+    options.engines[1].name = "engine1";
+    options.threads = static_cast<int>(std::thread::hardware_concurrency());
+    
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos)
+            continue;
+        
+        std::string key = arg.substr(0, eq);
+        const char* value = argv[i] + eq + 1;
+        
+        if (key == "games")
+            options.games = std::atoi(value);
+        else if (key == "threads")
+            options.threads = std::atoi(value);
+        else if (key == "elo0")
+            options.elo0 = std::atof(value);
+        else if (key == "elo1")
+            options.elo1 = std::atof(value);
+        else if (key == "alpha")
+            options.alpha = std::atof(value);
+        else if (key == "beta")
+            options.beta = std::atof(value);
+        else if (key.size() > 1 && (key.back() == '0' || key.back() == '1'))
+        {
+            SearchLimits& limits = options.engines[key.back() - '0'].limits;
+            std::string name = key.substr(0, key.size() - 1);
+            if (name == "depth")
+                limits.depth = std::atoi(value);
+            else if (name == "nodes")
+                limits.nodes = std::strtoull(value, nullptr, 10);
+            else if (name == "ms")
+                limits.milliseconds = std::atoi(value);
+        }
+    }
+    
+    Tournament tournament(options);
+    if (std::strcmp(argv[2], "-") != 0 && !tournament.loadOpenings(argv[2]))
+    {
+        std::cerr << "No openings read from " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    tournament.run();
+    return 0;
+}
+
+static int runAnalyze(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " analyze <positions.epd> [depth=N] [ms=N] [cache=file]"
+                  << " [shared=/name] [shard=I/N] [entries=N]" << std::endl;
+        return 1;
+    }
+    
+    SearchLimits limits;
+    const char* cachePath = nullptr;
+    const char* sharedName = nullptr;
+    int shard = 0, shards = 1;
+    size_t entries = 1 << 22;       // a shared segment that already exists keeps its own size
+    for (int i = 3; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "depth=", 6) == 0)
+            limits.depth = std::atoi(argv[i] + 6);
+        else if (std::strncmp(argv[i], "ms=", 3) == 0)
+            limits.milliseconds = std::atoi(argv[i] + 3);
+        else if (std::strncmp(argv[i], "cache=", 6) == 0)
+            cachePath = argv[i] + 6;
+        else if (std::strncmp(argv[i], "shared=", 7) == 0)
+            sharedName = argv[i] + 7;
+        else if (std::strncmp(argv[i], "shard=", 6) == 0)
+            std::sscanf(argv[i] + 6, "%d/%d", &shard, &shards);
+        else if (std::strncmp(argv[i], "entries=", 8) == 0)
+            entries = std::strtoull(argv[i] + 8, nullptr, 10);
+    }
+    
+    if (shards < 1 || shard < 0 || shard >= shards)
+    {
+        std::cerr << "Invalid shard " << shard << "/" << shards << std::endl;
+        return 1;
+    }
+    
+    std::ifstream in(argv[2]);
+    if (!in)
+    {
+        std::cerr << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+    
+    // Results of earlier runs are mapped at startup and saved back with this run's.
+    // A shared segment replaces the private table, which then stays minimal
+    TranspositionTable table(sharedName ? 1 : entries);
+    if (cachePath && !table.load(cachePath))
+        std::cerr << "Starting with an empty cache, " << cachePath << " is missing, has another version or other keys" << std::endl;
+    
+    // Processes working on other shards of the same file share their results
+    // through the segment
+    if (sharedName && !table.attachShared(sharedName, entries))
+    {
+        std::cerr << "Could not attach shared table " << sharedName << ", a stale one can be removed with shared-remove"
+                  << std::endl;
+        return 1;
+    }
+    
+    Search search;
+    search.setTable(&table);
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = 0;
+    std::string line;
+    for (int index = 0; std::getline(in, line); index++)
+    {
+        Board board;
+        if (index % shards != shard || line.empty())
+            continue;
+        if (!board.setFen(line))
+        {
+            std::cerr << "Skipping line " << index + 1 << ", not a legal position: " << line << std::endl;
+            continue;
+        }
+        
+        SearchResult result = search.run(board, limits);
+        nodes += result.nodes;
+        std::cout << board.getFen() << "  " << (result.hasMove ? result.best.toString() : "none")
+                  << " " << result.score << " " << result.nodes << std::endl;
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << nodes << " nodes in " << seconds << " s" << std::endl;
+    
+    if (cachePath && !table.save(cachePath))
+    {
+        std::cerr << "Could not write " << cachePath << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
+
+static int runSharedRemove(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " shared-remove </name>" << std::endl;
+        return 1;
+    }
+    
+    if (!TranspositionTable::removeShared(argv[2]))
+    {
+        std::cerr << "Could not remove " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int runCacheMerge(int argc, const char * argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " cache-merge <output> <input>..." << std::endl;
+        return 1;
+    }
+    
+    uint64_t written = 0;
+    if (!TranspositionTable::merge(std::vector<std::string>(argv + 3, argv + argc), argv[2], &written))
+    {
+        std::cerr << "Could not merge, an input is missing or has another version" << std::endl;
+        return 1;
+    }
+    
+    std::cout << written << " entries written to " << argv[2] << std::endl;
+    return 0;
+}
+
+static int runFuzz(int argc, const char * argv[])
+{
+    FuzzOptions options;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos)
+        {
+            std::cerr << "Usage: " << argv[0] << " fuzz [games=N] [plies=N] [seed=N] [probes=N] [search=N] [inputs=N]" << std::endl;
+            return 1;
+        }
+        
+        std::string key = arg.substr(0, eq);
+        const char* value = argv[i] + eq + 1;
+        
+        if (key == "games")
+            options.games = std::atoi(value);
+        else if (key == "plies")
+            options.plies = std::atoi(value);
+        else if (key == "seed")
+            options.seed = std::strtoull(value, nullptr, 10);
+        else if (key == "probes")
+            options.probes = std::atoi(value);
+        else if (key == "search")
+            options.searchEvery = std::atoi(value);
+        else if (key == "inputs")
+            options.inputs = std::atoi(value);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    FuzzReport report = Fuzz::run(options);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << "games:    " << report.games << std::endl;
+    std::cout << "moves:    " << report.moves << std::endl;
+    std::cout << "probes:   " << report.probes << std::endl;
+    std::cout << "searches: " << report.searches << std::endl;
+    std::cout << "inputs:   " << report.inputs << " (" << report.accepted << " accepted)" << std::endl;
+    std::cout << "failures: " << report.failures << std::endl;
+    std::cout << "time:     " << elapsed << " s" << std::endl;
+    
+    return report.failures == 0 ? 0 : 2;
+}
 
 int main(int argc, const char * argv[])
 {
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0)
+        return Benchmark::run(argc > 2 ? argv[2] : nullptr) == 0 ? 0 : 2;
+    if (argc > 1 && std::strcmp(argv[1], "replay") == 0)
+        return runReplay(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "serve") == 0)
+        return runServer(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "tournament") == 0)
+        return runTournament(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "analyze") == 0)
+        return runAnalyze(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "cache-merge") == 0)
+        return runCacheMerge(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "shared-remove") == 0)
+        return runSharedRemove(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "index") == 0)
+        return runIndex(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "query") == 0)
+        return runQuery(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "fuzz") == 0)
+        return runFuzz(argc, argv);
+    
     Game game;
     
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--book") == 0 && !game.loadBook(argv[i + 1]))
+            std::cerr << "Could not open opening book " << argv[i + 1] << std::endl;
+        else if (std::strcmp(argv[i], "--book-keys") == 0 && !Zobrist::loadPolyglotTable(argv[i + 1]))
+            std::cerr << "Could not read Polyglot key table " << argv[i + 1] << std::endl;
+    }
+    
     game.init();
     game.update();
     game.draw();